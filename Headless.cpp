@@ -0,0 +1,205 @@
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string_view>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#define SDL_MAIN_HANDLED
+#include <SDL.h>
+
+#include "FileLoader.hpp"
+#include "NullSoundMixer.hpp"
+#include "ObjectDataStore.hpp"
+#include "Rewind.hpp"
+#include "Simulation.hpp"
+#include "TextureLoader.hpp"
+#include "World.hpp"
+
+namespace fs = std::filesystem;
+
+using Clock = std::chrono::steady_clock;
+
+// in KiB
+static size_t getPeakMemory()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if(GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return counters.PeakWorkingSetSize / 1024;
+#else
+    rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+#ifdef __APPLE__
+        return usage.ru_maxrss / 1024; // bytes
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return 0;
+}
+
+static double toMs(Clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// runs the simulation without a window or audio and reports how fast it went
+// usage: BrickTrainHeadless [--ticks N] [--rewind-bench [interval ticks]] [save path]
+int main(int argc, char *argv[])
+{
+    unsigned int numTicks = 10000;
+    unsigned int rewindInterval = 0;
+    fs::path savePath;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(std::string_view(argv[i]) == "--ticks" && i + 1 < argc)
+            numTicks = std::max(1, atoi(argv[++i]));
+        else if(std::string_view(argv[i]) == "--rewind-bench")
+        {
+            // same as the game by default
+            rewindInterval = 100;
+
+            if(i + 1 < argc && atoi(argv[i + 1]) > 0)
+                rewindInterval = atoi(argv[++i]);
+        }
+        else
+            savePath = argv[i];
+    }
+
+    // get base path
+    fs::path basePath;
+    auto tmp = SDL_GetBasePath();
+    if(tmp)
+    {
+        basePath = fs::canonical(tmp);
+        SDL_free(tmp);
+    }
+
+    // setup loaders/resources
+    // no renderer, so no textures are loaded
+    FileLoader fileLoader(basePath);
+    TextureLoader texLoader(fileLoader);
+    ObjectDataStore objStore(fileLoader);
+    NullSoundMixer mixer;
+
+    fileLoader.addResourceFile("disc/art-res/resource");
+
+    if(savePath.empty())
+        savePath = fileLoader.getDataPath() / "disc/art-res/SAVEGAME/4BRIDGES.SAV";
+
+    // same seed every time, for comparable runs
+    World world(fileLoader, texLoader, objStore, 0);
+
+    auto loadStart = Clock::now();
+
+    if(!world.loadSave(savePath))
+    {
+        std::cerr << "Failed to load " << savePath << "\n";
+        return 1;
+    }
+
+    auto loadTime = Clock::now() - loadStart;
+
+    // same ticks as the real thing
+    const uint32_t tickMs = Simulation::tickMs;
+
+    world.setUpdateTimesEnabled(true);
+
+    // rewind states, kept for the whole run
+    RewindBuffer rewindBuffer;
+    std::vector<uint8_t> rewindState;
+    Clock::duration rewindSaveTime{0}, rewindPushTime{0}, rewindMaxTime{0};
+    size_t rewindStateBytes = 0;
+    unsigned int numRewindStates = 0;
+
+    auto start = Clock::now();
+
+    for(unsigned int i = 0; i < numTicks; i++)
+    {
+        world.update(tickMs, mixer);
+
+        if(rewindInterval && (i + 1) % rewindInterval == 0)
+        {
+            auto saveStart = Clock::now();
+            world.saveState(rewindState);
+
+            auto pushStart = Clock::now();
+            rewindBuffer.push(i + 1, rewindState);
+
+            auto end = Clock::now();
+
+            rewindSaveTime += pushStart - saveStart;
+            rewindPushTime += end - pushStart;
+            rewindMaxTime = std::max(rewindMaxTime, end - saveStart);
+            rewindStateBytes += rewindState.size();
+            numRewindStates++;
+        }
+    }
+
+    auto totalTime = Clock::now() - start;
+
+    // report
+    double totalMs = toMs(totalTime);
+    double simulatedMs = double(numTicks) * tickMs;
+
+    std::cout << "Loaded " << savePath << " in " << toMs(loadTime) << "ms\n";
+    std::cout << numTicks << " ticks (" << simulatedMs / 1000.0 << "s simulated) in " << totalMs << "ms\n";
+    std::cout << numTicks / (totalMs / 1000.0) << " ticks/s, " << simulatedMs / totalMs << "x real time\n";
+
+    auto &times = world.getUpdateTimes();
+
+    auto printTime = [totalMs](const char *name, Clock::duration time)
+    {
+        std::cout << "  " << name << ": " << toMs(time) << "ms (" << toMs(time) / totalMs * 100.0 << "%)\n";
+    };
+
+    printTime("motion", times.motion);
+    printTime("timers", times.timers);
+    printTime("animations", times.animations);
+    printTime("time events", times.timeEvents);
+    printTime("trains", times.trains);
+
+    if(numRewindStates)
+    {
+        std::cout << "Rewind: " << numRewindStates << " states every " << rewindInterval << " ticks\n";
+        std::cout << "  save: " << toMs(rewindSaveTime) / numRewindStates << "ms, delta: " << toMs(rewindPushTime) / numRewindStates << "ms, max: " << toMs(rewindMaxTime) << "ms per state\n";
+        std::cout << "  " << toMs(rewindSaveTime + rewindPushTime) / numTicks << "ms per tick, " << rewindStateBytes / numRewindStates << " bytes per state, " << rewindBuffer.getMemoryUsage() / numRewindStates << " stored\n";
+
+        // restoring a state and running again should end up in the same place
+        std::vector<uint8_t> endState;
+        world.saveState(endState);
+
+        uint64_t stateTick;
+        bool restored = rewindBuffer.get(numTicks / 2, rewindState, stateTick);
+
+        auto restoreStart = Clock::now();
+        restored = restored && world.restoreState(rewindState);
+        auto restoreTime = Clock::now() - restoreStart;
+
+        if(!restored)
+            std::cout << "  restore failed\n";
+        else
+        {
+            for(auto i = stateTick; i < numTicks; i++)
+                world.update(tickMs, mixer);
+
+            world.saveState(rewindState);
+
+            std::cout << "  restore: " << toMs(restoreTime) << "ms, replay from tick " << stateTick << (rewindState == endState ? " matched\n" : " did not match\n");
+        }
+    }
+
+    std::cout << "Peak memory: " << getPeakMemory() << "KiB\n";
+
+    return 0;
+}
@@ -1,20 +1,37 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <random>
 
 #include <SDL.h>
 #include <SDL_mixer.h>
 
 #include "FileLoader.hpp"
 #include "ObjectDataStore.hpp"
-#include "SoundMixer.hpp"
+#include "Recording.hpp"
+#include "RenderStats.hpp"
+#include "SaveLoader.hpp"
+#include "SDLRenderer.hpp"
+#include "SDLSoundMixer.hpp"
+#include "Simulation.hpp"
+#include "SoftwareRenderer.hpp"
 #include "TextureLoader.hpp"
 #include "World.hpp"
+#include "WorldManager.hpp"
+#include "WorldRenderer.hpp"
 
 namespace fs = std::filesystem;
 
 static bool quit = false;
+static bool redrawNeeded = true;
+static bool rewindEnabled = false;
+static bool switchEnabled = false, switchRequested = false;
 
-static void pollEvents(World &world)
+static const uint32_t rewindStep = 10 * 1000;
+
+static void pollEvents(Simulation &simulation, WorldRenderer &worldRenderer, RenderStats *renderStats)
 {
     SDL_Event event;
     while(SDL_PollEvent(&event))
@@ -28,29 +45,139 @@ static void pollEvents(World &world)
                     // get the real size used by the renderer
                     auto window = SDL_GetWindowFromID(event.window.windowID);
                     auto renderer = SDL_GetRenderer(window);
-                    int w, h;
-                    SDL_GetRendererOutputSize(renderer, &w, &h);
+                    SDL_GetRendererOutputSize(renderer, &event.window.data1, &event.window.data2);
 
-                    world.setWindowSize(w, h);
+                    simulation.queueEvent(event);
                 }
+                else if(event.window.event == SDL_WINDOWEVENT_EXPOSED)
+                    redrawNeeded = true;
                 break;
             }
             case SDL_QUIT:
                 quit = true;
                 break;
 
+            case SDL_KEYUP:
+            {
+                // toggle stats overlay
+                if(renderStats && event.key.keysym.scancode == SDL_SCANCODE_F3)
+                {
+                    renderStats->setOverlayEnabled(!renderStats->getOverlayEnabled());
+                    redrawNeeded = true;
+                }
+                else if(rewindEnabled && event.key.keysym.scancode == SDL_SCANCODE_F5)
+                    simulation.rewind(rewindStep);
+                else if(switchEnabled && event.key.keysym.scancode == SDL_SCANCODE_F6)
+                    switchRequested = true; // next save
+                else
+                    simulation.queueEvent(event);
+                break;
+            }
+
+            case SDL_MOUSEWHEEL:
+            {
+                // the world can't use the renderer from its thread, so convert coords for hidpi here
+                auto renderer = SDL_GetRenderer(SDL_GetWindowFromID(event.wheel.windowID));
+                float logMouseX, logMouseY;
+                SDL_RenderWindowToLogical(renderer, event.wheel.mouseX, event.wheel.mouseY, &logMouseX, &logMouseY);
+
+                event.wheel.mouseX = static_cast<int>(logMouseX);
+                event.wheel.mouseY = static_cast<int>(logMouseY);
+
+                simulation.queueEvent(event);
+                break;
+            }
+
+            case SDL_RENDER_TARGETS_RESET:
+            case SDL_RENDER_DEVICE_RESET:
+            {
+                // cached chunks are lost
+                worldRenderer.invalidate();
+                redrawNeeded = true;
+                break;
+            }
+
             default:
-                world.handleEvent(event);
+                if(event.type != simulation.getSnapshotEvent())
+                    simulation.queueEvent(event);
                 break;
         }
     }
 }
 
+static void drawProgressBar(Renderer &renderer, int outputWidth, int outputHeight, float progress)
+{
+    const int barHeight = 16;
+
+    int barWidth = outputWidth / 2;
+    int x = (outputWidth - barWidth) / 2;
+    int y = outputHeight - barHeight * 4;
+
+    renderer.setDrawColour(0, 0, 0, 255);
+    renderer.fillRect({x - 2, y - 2, barWidth + 4, barHeight + 4});
+
+    renderer.setDrawColour(255, 255, 255, 255);
+    renderer.drawRect({x - 1, y - 1, barWidth + 2, barHeight + 2});
+    renderer.fillRect({x, y, static_cast<int>(barWidth * progress), barHeight});
+}
+
 int main(int argc, char *argv[])
 {
     const int screenWidth = 1280;
     const int screenHeight = 1024;
 
+    // wake up occasionally even if nothing is scheduled
+    const uint32_t maxIdleDelay = 1000;
+
+    const uint32_t autosaveInterval = 60 * 1000;
+
+    // F5 goes back 10s, up to 5 minutes
+    const uint32_t rewindInterval = 1000;
+    const uint32_t rewindLength = 5 * 60 * 1000;
+
+    // time spent loading between frames, most of a 60Hz frame
+    const uint32_t loadFrameMs = 12;
+
+    // loading the next save's assets while running
+    const uint32_t pinFrameMs = 2;
+
+    bool softwareRender = false;
+    bool showStats = false;
+    unsigned int timeScale = 1;
+    unsigned int switchInterval = 0; // seconds
+    fs::path recordPath, replayPath, autosavePath;
+    std::vector<fs::path> savePaths;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(std::string_view(argv[i]) == "--software")
+            softwareRender = true;
+        else if(std::string_view(argv[i]) == "--stats")
+            showStats = true;
+        else if(std::string_view(argv[i]) == "--warp" && i + 1 < argc)
+        {
+            // --warp N runs N ticks in the time of one, --warp max as many as possible
+            std::string_view value(argv[++i]);
+
+            if(value == "max")
+                timeScale = 0;
+            else
+                timeScale = std::max(1, atoi(argv[i]));
+        }
+        else if(std::string_view(argv[i]) == "--record" && i + 1 < argc)
+            recordPath = argv[++i];
+        else if(std::string_view(argv[i]) == "--replay" && i + 1 < argc)
+            replayPath = argv[++i];
+        else if(std::string_view(argv[i]) == "--autosave" && i + 1 < argc)
+            autosavePath = argv[++i];
+        else if(std::string_view(argv[i]) == "--rewind")
+            rewindEnabled = true;
+        else if(std::string_view(argv[i]) == "--cycle" && i + 1 < argc)
+            switchInterval = std::max(0, atoi(argv[++i])); // seconds per save
+        else
+            savePaths.push_back(argv[i]); // F6 switches between them
+    }
+
     // get base path
     fs::path basePath;
     auto tmp = SDL_GetBasePath();
@@ -84,9 +211,9 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    auto renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC);
+    auto sdlRenderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_PRESENTVSYNC);
 
-    if(!renderer)
+    if(!sdlRenderer)
     {
         SDL_DestroyWindow(window);
         std::cerr << "Failed to create renderer:" << SDL_GetError() << "\n";
@@ -96,45 +223,210 @@ int main(int argc, char *argv[])
     // audio setup
     if(Mix_OpenAudio(44100, AUDIO_S16SYS, 2, 2048) != 0)
     {
-        SDL_DestroyRenderer(renderer);
+        SDL_DestroyRenderer(sdlRenderer);
         SDL_DestroyWindow(window);
         std::cerr << "Failed to open audio!\n";
         return 1;
     }
 
-    SoundMixer mixer(fileLoader);
+    SDLSoundMixer mixer(fileLoader);
+
+    // use our own renderer if SDL would be rendering in software anyway
+    SDL_RendererInfo rendererInfo;
+    if(SDL_GetRendererInfo(sdlRenderer, &rendererInfo) == 0 && (rendererInfo.flags & SDL_RENDERER_SOFTWARE))
+        softwareRender = true;
 
-    texLoader.setRenderer(renderer);
+    std::unique_ptr<Renderer> renderer;
+
+    if(softwareRender)
+        renderer = std::make_unique<SoftwareRenderer>(sdlRenderer);
+    else
+        renderer = std::make_unique<SDLRenderer>(sdlRenderer);
+
+    // count draws if requested
+    RenderStats *renderStats = nullptr;
+
+    if(showStats)
+    {
+        auto stats = std::make_unique<RenderStats>(std::move(renderer));
+        stats->setOverlayEnabled(true);
+        stats->setLogEnabled(true);
+
+        renderStats = stats.get();
+        renderer = std::move(stats);
+    }
+
+    texLoader.setRenderer(renderer.get());
+
+    // replays need the same seed and date/time as the recording
+    Recording recording;
+
+    if(!replayPath.empty())
+    {
+        if(!recording.load(replayPath))
+            return 1;
+    }
+    else
+        recording.randomSeed = std::random_device{}();
 
-    World testWorld(fileLoader, texLoader, objStore);
+    World testWorld(fileLoader, texLoader, objStore, recording.randomSeed);
+
+    if(!replayPath.empty())
+        testWorld.setDateTime(recording.dateTime);
+    else
+        recording.dateTime = testWorld.getDateTime();
+
+    WorldRenderer worldRenderer;
 
     testWorld.setWindowSize(screenWidth, screenHeight);
 
-    testWorld.loadSave(dataPath / "disc/art-res/SAVEGAME/4BRIDGES.SAV");
+    // scaling every copy is slow without a GPU
+    if(softwareRender)
+        worldRenderer.setRenderNativeScale(true);
+
+    // events are queued until the simulation starts
+    Simulation simulation(testWorld, mixer);
+
+    if(savePaths.empty())
+        savePaths.push_back(dataPath / "disc/art-res/SAVEGAME/4BRIDGES.SAV");
+
+    // switching would break recordings
+    switchEnabled = savePaths.size() > 1 && recordPath.empty() && replayPath.empty();
+
+    WorldManager worldManager(testWorld, texLoader, objStore);
+    worldManager.setRotation(savePaths);
+
+    // load a bit each frame, drawing the backdrop and a progress bar
+    // the simulation needs to be stopped
+    auto runSwitch = [&]()
+    {
+        RenderSnapshot loadSnapshot;
+        bool haveLoadSnapshot = false;
+
+        // nothing cached is useful for the new save
+        worldRenderer.invalidate();
+
+        while(!quit && worldManager.update(loadFrameMs, renderer.get()))
+        {
+            pollEvents(simulation, worldRenderer, renderStats);
+
+            int outputWidth, outputHeight;
+            SDL_GetRendererOutputSize(sdlRenderer, &outputWidth, &outputHeight);
+
+            // the backdrop is there once the header is loaded
+            // (not updated after that, copying all the objects every frame would slow down loading)
+            auto loader = worldManager.getLoader();
+
+            if(!haveLoadSnapshot && loader && loader->getPhase() != SaveLoader::Phase::Header)
+            {
+                testWorld.takeSnapshot(loadSnapshot);
+                haveLoadSnapshot = true;
+            }
+
+            renderer->setDrawColour(0, 0, 0, 255);
+            renderer->clear();
+
+            worldRenderer.render(*renderer, loadSnapshot, 1.0f);
+            drawProgressBar(*renderer, outputWidth, outputHeight, worldManager.getProgress());
+
+            renderer->present();
+        }
+
+        if(worldManager.getFailed())
+            std::cerr << "Failed to load " << savePaths[worldManager.getCurrent()] << "\n";
+
+        // make sure the simulation sends the loaded world
+        testWorld.setRedrawNeeded();
+        redrawNeeded = true;
+    };
+
+    worldManager.switchTo(0);
+    runSwitch();
 
-    uint32_t lastTime = SDL_GetTicks();
+    // the world is only touched by the simulation thread from here
+    simulation.setTimeScale(timeScale);
+
+    if(!replayPath.empty())
+        simulation.replay(recording);
+    else if(!recordPath.empty())
+        simulation.record(recording);
+
+    if(!autosavePath.empty())
+        simulation.setAutosave(autosavePath, autosaveInterval);
+
+    if(rewindEnabled)
+        simulation.setRewind(rewindInterval, rewindLength);
+
+    auto startTime = std::chrono::steady_clock::now();
+    auto switchTime = startTime;
+
+    simulation.start();
+
+    float lastInterpolation = 1.0f;
 
     while(!quit)
     {
-        pollEvents(testWorld);
+        pollEvents(simulation, worldRenderer, renderStats);
 
-        uint32_t now = SDL_GetTicks();
-        auto delta = now - lastTime;
-        lastTime = now;
+        if(simulation.getReplayFinished())
+            quit = true;
+
+        if(switchEnabled && switchInterval && std::chrono::steady_clock::now() - switchTime >= std::chrono::seconds(switchInterval))
+            switchRequested = true;
+
+        if(switchRequested)
+        {
+            switchRequested = false;
+
+            simulation.stop();
+            worldManager.switchToNext();
+            runSwitch();
+            simulation.start();
+
+            switchTime = std::chrono::steady_clock::now();
+        }
 
-        testWorld.update(delta, mixer);
+        // get the next save ready in the background
+        bool pinning = switchEnabled && worldManager.pinNext(pinFrameMs, renderer.get());
 
-        SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-        SDL_RenderClear(renderer);
+        if(simulation.updateSnapshot())
+            redrawNeeded = true;
 
-        testWorld.render(renderer);
+        // keep drawing while moving objects are between ticks
+        float interpolation = simulation.getInterpolation();
 
-        SDL_RenderPresent(renderer);
+        if(redrawNeeded || interpolation != lastInterpolation)
+        {
+            renderer->setDrawColour(0, 0, 0, 255);
+            renderer->clear();
+
+            worldRenderer.render(*renderer, simulation.getSnapshot(), interpolation);
+
+            renderer->present();
+
+            redrawNeeded = false;
+            lastInterpolation = interpolation;
+        }
+        else if(!pinning)
+        {
+            // nothing changed, sleep until there's a new snapshot or an event
+            SDL_WaitEventTimeout(nullptr, maxIdleDelay);
+        }
+    }
+
+    simulation.stop();
+
+    if(!replayPath.empty())
+    {
+        auto time = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        std::cout << "Replayed " << simulation.getTickCount() << " ticks in " << time << "s\n";
     }
+    else if(!recordPath.empty())
+        recording.save(recordPath);
 
     Mix_CloseAudio();
 
-    SDL_DestroyRenderer(renderer);
+    SDL_DestroyRenderer(sdlRenderer);
     SDL_DestroyWindow(window);
 
     return 0;
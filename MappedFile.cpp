@@ -0,0 +1,114 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "MappedFile.hpp"
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::filesystem::path &path)
+{
+    close();
+
+#ifdef _WIN32
+    fileHandle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if(fileHandle == INVALID_HANDLE_VALUE)
+    {
+        fileHandle = nullptr;
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+
+    mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if(!mappingHandle)
+    {
+        close();
+        return false;
+    }
+
+    data = static_cast<const uint8_t *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    size = fileSize.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if(fd == -1)
+        return false;
+
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    auto ptr = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping keeps the file open
+    ::close(fd);
+
+    if(ptr == MAP_FAILED)
+        return false;
+
+    // it's read front to back
+    madvise(ptr, fileStat.st_size, MADV_SEQUENTIAL);
+
+    data = static_cast<const uint8_t *>(ptr);
+    size = fileStat.st_size;
+#endif
+
+    if(!data)
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if(data)
+        UnmapViewOfFile(data);
+
+    if(mappingHandle)
+        CloseHandle(mappingHandle);
+
+    if(fileHandle)
+        CloseHandle(fileHandle);
+
+    fileHandle = mappingHandle = nullptr;
+#else
+    if(data)
+        munmap(const_cast<uint8_t *>(data), size);
+#endif
+
+    data = nullptr;
+    size = 0;
+}
+
+const uint8_t *MappedFile::getData() const
+{
+    return data;
+}
+
+size_t MappedFile::getSize() const
+{
+    return size;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+
+// read-only memory mapping of a whole file
+class MappedFile final
+{
+public:
+    MappedFile() = default;
+    MappedFile(MappedFile &) = delete;
+    ~MappedFile();
+
+    bool open(const std::filesystem::path &path);
+    void close();
+
+    const uint8_t *getData() const;
+    size_t getSize() const;
+
+private:
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+
+#ifdef _WIN32
+    void *fileHandle = nullptr, *mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,279 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <unordered_map>
+
+#include "NativeSave.hpp"
+
+namespace NativeSave
+{
+    // dedupes names, most are empty
+    class StringPool final
+    {
+    public:
+        StringPool()
+        {
+            data.push_back(0);
+        }
+
+        uint32_t add(std::string_view str)
+        {
+            if(str.empty())
+                return 0;
+
+            auto it = offsets.find(std::string(str));
+
+            if(it != offsets.end())
+                return it->second;
+
+            uint32_t offset = data.size();
+            data.insert(data.end(), str.begin(), str.end());
+            data.push_back(0);
+
+            offsets.emplace(str, offset);
+
+            return offset;
+        }
+
+        const std::vector<char> &getData() const {return data;}
+
+    private:
+        std::vector<char> data;
+        std::unordered_map<std::string, uint32_t> offsets;
+    };
+
+    static void encodeCoords(const std::vector<uint16_t> &coords, std::vector<uint8_t> &out)
+    {
+        int prev = 0;
+
+        for(auto coord : coords)
+        {
+            int delta = coord - prev;
+            prev = coord;
+
+            // zigzag so small negative deltas are small too
+            uint32_t value = delta < 0 ? (uint32_t(-delta) << 1) - 1 : uint32_t(delta) << 1;
+
+            while(value >= 0x80)
+            {
+                out.push_back(value | 0x80);
+                value >>= 7;
+            }
+
+            out.push_back(value);
+        }
+    }
+
+    // fixed length, maybe not terminated
+    static std::string_view getFixedString(const uint8_t *data, size_t maxLen)
+    {
+        auto str = reinterpret_cast<const char *>(data);
+        return {str, strnlen(str, maxLen)};
+    }
+
+    bool convert(const std::filesystem::path &savPath, const std::filesystem::path &outPath, bool deltaCoords)
+    {
+        std::ifstream file(savPath, std::ios::binary);
+
+        if(!file)
+        {
+            std::cerr << "Failed to open " << savPath << "\n";
+            return false;
+        }
+
+        uint8_t savHeader[0x114];
+
+        if(file.read(reinterpret_cast<char *>(savHeader), sizeof(savHeader)).gcount() != sizeof(savHeader))
+        {
+            std::cerr << "Failed to read header for " << savPath << "\n";
+            return false;
+        }
+
+        Header header{};
+        memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.flags = deltaCoords ? uint32_t(DeltaCoords) : 0u;
+        header.width = savHeader[2] | savHeader[3] << 8;
+        header.height = savHeader[4] | savHeader[5] << 8;
+        header.numObjects = savHeader[8] | savHeader[9] << 8 | savHeader[10] << 16 | savHeader[11] << 24;
+        header.numTrains = savHeader[12] | savHeader[13] << 8;
+
+        StringPool strings;
+        header.backdropName = strings.add(getFixedString(savHeader + 14, sizeof(savHeader) - 14));
+
+        std::vector<uint8_t> tileTypes(size_t(header.width) * header.height);
+
+        if(file.read(reinterpret_cast<char *>(tileTypes.data()), tileTypes.size()).gcount() != std::streamsize(tileTypes.size()))
+        {
+            std::cerr << "Failed to read tile type data for " << savPath << "\n";
+            return false;
+        }
+
+        // split the objects into columns
+        std::vector<uint16_t> ids, xs, ys;
+        std::vector<int32_t> framesets;
+        std::vector<uint32_t> names;
+        std::vector<Minifig> minifigs;
+
+        ids.reserve(header.numObjects);
+        xs.reserve(header.numObjects);
+        ys.reserve(header.numObjects);
+        framesets.reserve(header.numObjects);
+        names.reserve(header.numObjects);
+
+        for(uint32_t i = 0; i < header.numObjects; i++)
+        {
+            uint8_t objectData[0x80];
+
+            if(file.read(reinterpret_cast<char *>(objectData), sizeof(objectData)).gcount() != sizeof(objectData))
+            {
+                std::cerr << "Failed to read object " << i << " in " << savPath << "\n";
+                return false;
+            }
+
+            ids.push_back(objectData[0] | objectData[1] << 8);
+            xs.push_back(objectData[2] | objectData[3] << 8);
+            ys.push_back(objectData[4] | objectData[5] << 8);
+            framesets.push_back(objectData[8] | objectData[9] << 8 | objectData[10] << 16 | objectData[11] << 24);
+            names.push_back(strings.add(getFixedString(objectData + 16, 12)));
+
+            auto minifigData = objectData + 0x1C;
+            for(int j = 0; j < 5; j++, minifigData += 20)
+            {
+                uint32_t minifigId = minifigData[0] | minifigData[1] << 8 | minifigData[2] << 16 | minifigData[3] << 24;
+                auto minifigName = getFixedString(minifigData + 8, 12);
+
+                if(minifigId || !minifigName.empty())
+                    minifigs.push_back({i, minifigId, strings.add(minifigName)});
+            }
+        }
+
+        header.numMinifigs = minifigs.size();
+
+        std::vector<Train> trains;
+
+        for(uint32_t i = 0; i < header.numTrains; i++)
+        {
+            uint8_t trainData[44];
+
+            if(file.read(reinterpret_cast<char *>(trainData), sizeof(trainData)).gcount() != sizeof(trainData))
+            {
+                std::cerr << "Failed to read train " << i << " in " << savPath << "\n";
+                return false;
+            }
+
+            Train train;
+            memcpy(train.ids, trainData, sizeof(train.ids));
+            memcpy(train.types, trainData + 16, sizeof(train.types));
+            train.name = strings.add(getFixedString(trainData + 32, 12));
+
+            trains.push_back(train);
+        }
+
+        std::vector<uint8_t> encodedXs, encodedYs;
+
+        if(deltaCoords)
+        {
+            encodeCoords(xs, encodedXs);
+            encodeCoords(ys, encodedYs);
+        }
+
+        // lay out the sections
+        uint64_t offset = sizeof(Header);
+
+        auto place = [&offset](Section &section, uint64_t size)
+        {
+            offset = (offset + 7) & ~7ull;
+            section = {offset, size};
+            offset += size;
+        };
+
+        place(header.tileTypes, tileTypes.size());
+        place(header.ids, ids.size() * sizeof(uint16_t));
+
+        if(deltaCoords)
+        {
+            place(header.xs, encodedXs.size());
+            place(header.ys, encodedYs.size());
+        }
+        else
+        {
+            place(header.xs, xs.size() * sizeof(uint16_t));
+            place(header.ys, ys.size() * sizeof(uint16_t));
+        }
+
+        place(header.framesets, framesets.size() * sizeof(int32_t));
+        place(header.names, names.size() * sizeof(uint32_t));
+        place(header.minifigs, minifigs.size() * sizeof(Minifig));
+        place(header.trains, trains.size() * sizeof(Train));
+        place(header.strings, strings.getData().size());
+
+        std::ofstream out(outPath, std::ios::binary);
+
+        if(!out)
+        {
+            std::cerr << "Failed to open " << outPath << "\n";
+            return false;
+        }
+
+        auto write = [&out](const Section &section, const void *data)
+        {
+            // padding
+            static const char zeros[8]{};
+            out.write(zeros, section.offset - static_cast<uint64_t>(out.tellp()));
+
+            out.write(reinterpret_cast<const char *>(data), section.size);
+        };
+
+        out.write(reinterpret_cast<char *>(&header), sizeof(header));
+
+        write(header.tileTypes, tileTypes.data());
+        write(header.ids, ids.data());
+        write(header.xs, deltaCoords ? encodedXs.data() : static_cast<void *>(xs.data()));
+        write(header.ys, deltaCoords ? encodedYs.data() : static_cast<void *>(ys.data()));
+        write(header.framesets, framesets.data());
+        write(header.names, names.data());
+        write(header.minifigs, minifigs.data());
+        write(header.trains, trains.data());
+        write(header.strings, strings.getData().data());
+
+        if(!out)
+        {
+            std::cerr << "Failed to write " << outPath << "\n";
+            return false;
+        }
+
+        return true;
+    }
+
+    bool decodeCoords(const uint8_t *data, size_t size, uint32_t count, std::vector<uint16_t> &out)
+    {
+        out.resize(count);
+
+        auto end = data + size;
+        int prev = 0;
+
+        for(uint32_t i = 0; i < count; i++)
+        {
+            uint32_t value = 0;
+            int shift = 0;
+
+            do
+            {
+                if(data == end || shift > 28)
+                    return false;
+
+                value |= uint32_t(*data & 0x7F) << shift;
+                shift += 7;
+            }
+            while(*data++ & 0x80);
+
+            int delta = value & 1 ? -int((value + 1) >> 1) : int(value >> 1);
+            prev += delta;
+            out[i] = prev;
+        }
+
+        return true;
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+// native save format, the same contents as a .SAV but stored in columns
+// so that it can be mapped and loaded in bulk
+// everything is little endian, sections are aligned to 8 bytes
+namespace NativeSave
+{
+    const char magic[4]{'B', 'T', 'W', 'S'};
+    const uint32_t version = 1;
+
+    enum Flags : uint32_t
+    {
+        DeltaCoords = 1 << 0, // x/y are zigzag varints of the difference from the previous object
+    };
+
+    struct Section
+    {
+        uint64_t offset, size; // in bytes from the start of the file
+    };
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t flags;
+        uint16_t width, height;
+
+        uint32_t numObjects;
+        uint32_t numMinifigs;
+        uint32_t numTrains;
+        uint32_t backdropName; // string
+
+        Section tileTypes; // uint8_t[width * height]
+
+        // objects
+        Section ids; // uint16_t[numObjects]
+        Section xs, ys; // uint16_t[numObjects] or varints
+        Section framesets; // int32_t[numObjects]
+        Section names; // string[numObjects]
+
+        Section minifigs; // Minifig[numMinifigs], sorted by object
+        Section trains; // Train[numTrains]
+
+        // null terminated, a string is an offset in here
+        // 0 is always an empty string
+        Section strings;
+    };
+
+    // only the ones that aren't empty
+    struct Minifig
+    {
+        uint32_t object; // index
+        uint32_t id;
+        uint32_t name;
+    };
+
+    struct Train
+    {
+        uint32_t ids[4]; // engine + carriages
+        uint32_t types[4];
+        uint32_t name;
+    };
+
+    // reads a .SAV and writes it in the native format
+    bool convert(const std::filesystem::path &savPath, const std::filesystem::path &outPath, bool deltaCoords);
+
+    // decodes a varint coordinate section, false if it's truncated
+    bool decodeCoords(const uint8_t *data, size_t size, uint32_t count, std::vector<uint16_t> &out);
+}
@@ -0,0 +1,16 @@
+#include "NullSoundMixer.hpp"
+
+std::shared_ptr<Mix_Chunk> NullSoundMixer::loadSound(int32_t id)
+{
+    return nullptr;
+}
+
+uint32_t NullSoundMixer::playSound(const std::shared_ptr<Mix_Chunk> &sound, int priority)
+{
+    return ~0u;
+}
+
+bool NullSoundMixer::isSoundPlaying(uint32_t id) const
+{
+    return false;
+}
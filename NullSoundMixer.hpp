@@ -0,0 +1,14 @@
+#pragma once
+
+#include "SoundMixer.hpp"
+
+// doesn't load or play anything, for running without an audio device
+class NullSoundMixer final : public SoundMixer
+{
+public:
+    std::shared_ptr<Mix_Chunk> loadSound(int32_t id) override;
+
+    uint32_t playSound(const std::shared_ptr<Mix_Chunk> &sound, int priority) override;
+
+    bool isSoundPlaying(uint32_t id) const override;
+};
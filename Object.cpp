@@ -1,195 +1,232 @@
 #include "Object.hpp"
 
+#include <cmath>
+#include <cstring>
+
 #include "SoundMixer.hpp"
 #include "World.hpp"
 
-Object::Object(uint16_t id, uint16_t x, uint16_t y, std::string name, std::shared_ptr<SDL_Texture> texture, const ObjectData *data) : id(id), x(x), y(y), name(name), texture(texture), data(data)
+Object::Object(uint16_t id, uint16_t x, uint16_t y, std::string name, std::shared_ptr<Texture> texture, const ObjectData *data, ObjectStates &states) :
+    id(id), x(x), y(y), name(name), texture(texture), data(data), states(&states), state(states.allocate())
 {
     // set the default animation
     setDefaultAnimation();
 }
 
-void Object::update(uint32_t deltaMs, SoundMixer &soundMix)
+Object::Object(Object &&other) :
+    id(other.id), x(other.x), y(other.y), name(std::move(other.name)), serial(other.serial), texture(std::move(other.texture)), data(other.data),
+    minifigs(std::move(other.minifigs)), states(other.states), state(other.state), animationTimer(other.animationTimer),
+    localTime(other.localTime), soundReplayTime(other.soundReplayTime), playingSoundId(other.playingSoundId), lastSound(std::move(other.lastSound))
+{
+    // state belongs to the new object now
+    other.states = nullptr;
+}
+
+Object::~Object()
+{
+    if(states)
+        states->release(state);
+}
+
+// for objects that aren't on a World's timer wheel (train parts)
+bool Object::update(uint32_t deltaMs, SoundMixer &soundMix)
 {
     if(!data)
-        return;
+        return false;
 
-    if(velX || velY)
-    {
-        auto delta = static_cast<float>(deltaMs) / 1000.0f;
-        pixelX += velX * delta;
-        pixelY += velY * delta;
+    // used to report if anything visible changed
+    int oldAnimation = states->currentAnimation[state];
+    int oldFrame = states->animationFrame[state];
 
-        bool done =  (velX > 0 && pixelX >= targetX)
-                  || (velX < 0 && pixelX <= targetX)
-                  || (velY > 0 && pixelY >= targetY)
-                  || (velY < 0 && pixelY <= targetY);
+    bool moving = isMoving();
 
-        if(done)
-        {
-            if(reverse)
-            {
-                // go back to original pos
-                targetX = x;
-                targetY = y;
-                velX = -velX;
-                velY = -velY;
-                reverse = false;
-            }
-            else
-            {
-                // mark object to be removed
-                id = 0xFFFF;
-            }
-        }
+    if(moving)
+    {
+        updateMotion(deltaMs);
+        checkTarget();
     }
 
-    // update sound timer
-    if(soundReplayTimer > 0)
-        soundReplayTimer -= deltaMs;
+    localTime += deltaMs;
+
+    std::vector<SoundRequest> sounds;
 
     // update animations
-    if(!animationTimer && nextAnimation != -1)
+    if(isAnimationPending())
     {
         // start next animation if no current one
-        startAnimation(nextAnimation, soundMix);
-        animationTimer += getFrameDelay();
-        nextAnimation = -1;
+        stepAnimation(localTime, sounds, animationTimer);
     }
 
-    if(currentAnimation != -1 && animationTimer)
+    if(states->animationActive[state])
     {
         animationTimer -= deltaMs;
 
-        while(animationTimer <= 0)
+        while(states->animationActive[state] && animationTimer <= 0)
         {
-            auto &frameset = data->framesets[currentAnimation];
+            int delay;
+            stepAnimation(localTime, sounds, delay);
 
-            // if start > end, play backwards
-            int dir = frameset.startFrame > frameset.endFrame ? -1 : 1;
-
-            if(frameset.splitFrames)
-                dir *= 2;
-
-            if(nextAnimation != -1)
-            {
-                // delayed frameset change
-                startAnimation(nextAnimation, soundMix);
-                nextAnimation = -1;
-            }
-            else
-                currentAnimationFrame += dir;
-
-            // check if we've reached the end
-            if((dir > 0 && currentAnimationFrame > frameset.endFrame) || (dir < 0 && currentAnimationFrame < frameset.endFrame))
-            {
-                currentAnimationFrame = frameset.endFrame; // hold the last frame
-
-                // move to next animation if one set
-                if(frameset.nextFrameSet != -1)
-                {
-                    nextAnimation = frameset.nextFrameSet;
-                    animationTimer = frameset.restartDelay * 1000;
-                    continue;
-                }
-
-                // otherwise stop
+            if(delay < 0)
                 animationTimer = 0;
-                break;
-            }
-
-            animationTimer += getFrameDelay();
+            else
+                animationTimer += delay;
         }
     }
+
+    for(auto &sound : sounds)
+        playSound(sound, soundMix);
+
+    return moving || states->currentAnimation[state] != oldAnimation || states->animationFrame[state] != oldFrame;
 }
 
-void Object::render(SDL_Renderer *renderer, int scrollX, int scrollY, int z, float zoom)
+void Object::beginTick()
 {
-    if(!texture || !data)
+    states->lastPixelX[state] = states->pixelX[state];
+    states->lastPixelY[state] = states->pixelY[state];
+}
+
+// applies velocity, stopped objects have a velocity of 0
+void Object::updateMotion(uint32_t deltaMs)
+{
+    auto delta = static_cast<float>(deltaMs) / 1000.0f;
+    states->pixelX[state] += states->velX[state] * delta;
+    states->pixelY[state] += states->velY[state] * delta;
+}
+
+// after moving, reverse or remove when the target is reached
+void Object::checkTarget()
+{
+    if(!states->hasArrived(state))
         return;
 
-    int frameW, frameH;
-    std::tie(frameW, frameH) = getFrameSize();
+    if(states->reverse[state])
+    {
+        // go back to original pos
+        states->targetX[state] = x;
+        states->targetY[state] = y;
+        states->velX[state] = -states->velX[state];
+        states->velY[state] = -states->velY[state];
+        states->reverse[state] = false;
+    }
+    else
+    {
+        // mark object to be removed
+        id = 0xFFFF;
+    }
+}
+
+bool Object::isMoving() const
+{
+    return states->velX[state] || states->velY[state];
+}
 
-    // animation info
-    auto frameset = getCurrentFrameset();
+// starts the pending animation or advances a frame
+// nextDelay is the time until this should be called again, or -1 if the animation stopped
+// (sounds are returned instead of played so that this can be used from multiple threads)
+bool Object::stepAnimation(uint64_t now, std::vector<SoundRequest> &sounds, int &nextDelay)
+{
+    nextDelay = -1;
 
-    int frameOffset = currentAnimationFrame * frameW;
+    if(!data)
+        return false;
 
-    // if there's no occupancy data, draw the whole thing
-    if(data->bitmapOccupancy.empty() && z == 6)
+    int oldAnimation = states->currentAnimation[state];
+    int oldFrame = states->animationFrame[state];
+
+    if(!states->animationActive[state])
     {
-        // ... using pixel offsets
-        SDL_Rect dr{
-            static_cast<int>(pixelX * zoom) - scrollX,
-            static_cast<int>(pixelY * zoom) - scrollY,
-            static_cast<int>(frameW * zoom),
-            static_cast<int>(frameH * zoom)
-        };
-
-        SDL_Rect sr = {
-            frameOffset,
-            0,
-            frameW,
-            frameH
-        };
-
-        bool flipX = frameset && frameset->flipX;
-
-        // also need to apply hotspot
-        // (definitely used for the rainbow)
-        dr.x -= data->hotspotX * zoom;
-        dr.y -= data->hotspotY * zoom;
-
-        SDL_RenderCopyEx(renderer, texture.get(), &sr, &dr, 0.0, nullptr, flipX ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE);
-        return;
+        if(states->nextAnimation[state] == -1)
+            return false;
+
+        startAnimation(states->nextAnimation[state], now, sounds);
+        states->nextAnimation[state] = -1;
+        states->animationActive[state] = true;
+
+        nextDelay = getFrameDelay();
+        return true;
     }
 
-    // "split" frames render a second image above the first one
-    bool split = frameset ? frameset->splitFrames : false;
+    auto &frameset = data->framesets[states->currentAnimation[state]];
 
-    if(z > data->maxBitmapOccupancy + (split ? 1 : 0))
-        return;
+    // if start > end, play backwards
+    int dir = frameset.startFrame > frameset.endFrame ? -1 : 1;
 
-    auto tileSize = World::tileSize;
+    if(frameset.splitFrames)
+        dir *= 2;
 
-    // copy frame
-    for(int ty = 0; ty < int(data->bitmapSizeY); ty++)
+    if(states->nextAnimation[state] != -1)
     {
-        for(int tx = 0; tx < int(data->bitmapSizeX); tx++)
+        // delayed frameset change
+        startAnimation(states->nextAnimation[state], now, sounds);
+        states->nextAnimation[state] = -1;
+    }
+    else
+        states->animationFrame[state] += dir;
+
+    // check if we've reached the end
+    if((dir > 0 && states->animationFrame[state] > frameset.endFrame) || (dir < 0 && states->animationFrame[state] < frameset.endFrame))
+    {
+        states->animationFrame[state] = frameset.endFrame; // hold the last frame
+
+        // move to next animation if one set
+        if(frameset.nextFrameSet != -1)
         {
-            // TODO: x flip
-            int tileZ = data->bitmapOccupancy[tx + ty * data->bitmapSizeX];
-            
-            SDL_Rect sr{frameOffset + tx * tileSize, ty * tileSize, tileSize, tileSize};
-            SDL_Rect dr{
-                static_cast<int>((x + tx) * tileSize * zoom) - scrollX,
-                static_cast<int>((y + ty) * tileSize * zoom) - scrollY,
-                static_cast<int>(tileSize * zoom),
-                static_cast<int>(tileSize * zoom)
-            };
-
-            if(tileZ == z)
-                SDL_RenderCopy(renderer, texture.get(), &sr, &dr);
-            // TODO: try to combine?
-
-            if(split && tileZ + 1 == z)
-            {
-                // second layer, a bit higher
-                sr.x += frameW;
-                SDL_RenderCopy(renderer, texture.get(), &sr, &dr);
-            }
+            states->nextAnimation[state] = frameset.nextFrameSet;
+            nextDelay = frameset.restartDelay * 1000;
         }
+        else
+            states->animationActive[state] = false; // otherwise stop
     }
+    else
+        nextDelay = getFrameDelay();
+
+    return states->currentAnimation[state] != oldAnimation || states->animationFrame[state] != oldFrame;
+}
+
+bool Object::isAnimationPending() const
+{
+    return !states->animationActive[state] && states->nextAnimation[state] != -1;
+}
+
+uint32_t Object::getAnimationSerial() const
+{
+    return states->animationSerial[state];
+}
+
+uint32_t Object::newAnimationSerial()
+{
+    return ++states->animationSerial[state];
 }
 
-void Object::renderDebug(SDL_Renderer *renderer, int scrollX, int scrollY, float zoom)
+RenderSnapshot::Sprite Object::getSprite() const
+{
+    float lastX = states->lastPixelX[state];
+    float lastY = states->lastPixelY[state];
+
+    // not ticked since it was created
+    if(std::isnan(lastX))
+    {
+        lastX = states->pixelX[state];
+        lastY = states->pixelY[state];
+    }
+
+    return {
+        texture, data, getCurrentFrameset(), states->animationFrame[state],
+        x, y,
+        states->pixelX[state], states->pixelY[state],
+        lastX, lastY,
+        isStatic(),
+        serial
+    };
+}
+
+void Object::renderDebug(Renderer &renderer, int scrollX, int scrollY, float zoom)
 {
     if(!data)
         return;
 
     // "coords"
-    SDL_SetRenderDrawColor(renderer, 255, 0, 0, 255);
+    renderer.setDrawColour(255, 0, 0, 255);
 
     auto getXPos = [this, zoom, scrollX](int xOff) -> int
     {
@@ -202,50 +239,50 @@ void Object::renderDebug(SDL_Renderer *renderer, int scrollX, int scrollY, float
     };
 
     for(auto &coord : data->coords)
-        SDL_RenderDrawPoint(renderer, getXPos(std::get<0>(coord)), getYPos(std::get<1>(coord)));
+        renderer.drawPoint(getXPos(std::get<0>(coord)), getYPos(std::get<1>(coord)));
 
     // the other set (points/cross)
-    SDL_SetRenderDrawColor(renderer, 255, 0, 255, 255);
+    renderer.setDrawColour(255, 0, 255, 255);
 
     for(auto &coord : data->altCoords)
-        SDL_RenderDrawPoint(renderer, getXPos(std::get<0>(coord)), getYPos(std::get<1>(coord)));
+        renderer.drawPoint(getXPos(std::get<0>(coord)), getYPos(std::get<1>(coord)));
 
     // entry/exit
-    SDL_SetRenderDrawColor(renderer, 0, 255, 0, 255);
+    renderer.setDrawColour(0, 255, 0, 255);
 
     // left
     int px = 0;
     int py = data->entryExitOffsets[0];
     if(py)
-        SDL_RenderDrawPoint(renderer, getXPos(px), getYPos(py));
+        renderer.drawPoint(getXPos(px), getYPos(py));
 
     // bottom
     px = data->entryExitOffsets[1];
     py = data->bitmapSizeY * World::tileSize - 1;
     if(px)
-        SDL_RenderDrawPoint(renderer, getXPos(px), getYPos(py));
+        renderer.drawPoint(getXPos(px), getYPos(py));
 
     // right
     px = data->bitmapSizeX * World::tileSize - 1;
     py = data->entryExitOffsets[2];
     if(py)
-        SDL_RenderDrawPoint(renderer, getXPos(px), getYPos(py));
+        renderer.drawPoint(getXPos(px), getYPos(py));
 
     // top
     px = data->entryExitOffsets[3];
     py = 0;
     if(px)
-        SDL_RenderDrawPoint(renderer, getXPos(px), getYPos(py));
+        renderer.drawPoint(getXPos(px), getYPos(py));
 
     // free to roam
-    SDL_SetRenderDrawColor(renderer, 0, 0, 255, 255);
+    renderer.setDrawColour(0, 0, 255, 255);
     SDL_Rect r{getXPos(data->freeToRoam[0]), getYPos(data->freeToRoam[1]), data->freeToRoam[2] - data->freeToRoam[0], data->freeToRoam[3] - data->freeToRoam[1]};
     
     if(r.w && r.h)
     {
         r.w *= zoom;
         r.h *= zoom;
-        SDL_RenderDrawRect(renderer, &r);
+        renderer.drawRect(r);
     }
 }
 
@@ -254,6 +291,21 @@ uint16_t Object::getId() const
     return id;
 }
 
+const std::string &Object::getName() const
+{
+    return name;
+}
+
+uint32_t Object::getSerial() const
+{
+    return serial;
+}
+
+void Object::setSerial(uint32_t newSerial)
+{
+    serial = newSerial;
+}
+
 int Object::getX() const
 {
     return x;
@@ -286,7 +338,7 @@ const ObjectData *Object::getData() const
 }
 
 
-void Object::replace(uint16_t newId, std::shared_ptr<SDL_Texture> newTex, const ObjectData *newData)
+void Object::replace(uint16_t newId, std::shared_ptr<Texture> newTex, const ObjectData *newData)
 {
     id = newId;
     texture = newTex;
@@ -298,14 +350,29 @@ void Object::addMinifig(Minifig &&minifig)
     minifigs.emplace_back(std::move(minifig));
 }
 
+void Object::setMinifigs(std::vector<Minifig> &&newMinifigs)
+{
+    minifigs = std::move(newMinifigs);
+}
+
+const std::vector<Minifig> &Object::getMinifigs() const
+{
+    return minifigs;
+}
+
 const ObjectData::Frameset *Object::getCurrentFrameset() const
 {
-    if(currentAnimation != -1)
-        return &data->framesets[currentAnimation];
+    if(states->currentAnimation[state] != -1)
+        return &data->framesets[states->currentAnimation[state]];
 
     return nullptr;
 }
 
+int Object::getAnimation() const
+{
+    return states->currentAnimation[state];
+}
+
 int Object::getFrameDelay() const
 {
     auto frameset = getCurrentFrameset();
@@ -326,7 +393,8 @@ bool Object::setAnimation(int index)
     if(index < 0 || !data || index > data->numFramesets)
         return false;
 
-    nextAnimation = index;
+    states->nextAnimation[state] = index;
+    states->animationActive[state] = false;
     animationTimer = 0;
 
     return true;
@@ -343,7 +411,8 @@ bool Object::setAnimation(std::string_view name)
     {
         if(fs.name == name)
         {
-            nextAnimation = index;
+            states->nextAnimation[state] = index;
+            states->animationActive[state] = false;
             animationTimer = 0;
             return true;
         }
@@ -361,7 +430,12 @@ void Object::setAnimationFrame(int frame)
     if(frame < 0 || frame > data->totalFrames)
         return;
 
-    currentAnimationFrame = frame;
+    states->animationFrame[state] = frame;
+}
+
+int Object::getAnimationFrame() const
+{
+    return states->animationFrame[state];
 }
 
 std::tuple<int, int> Object::getFrameSize() const
@@ -374,55 +448,155 @@ std::tuple<int, int> Object::getFrameSize() const
         return {data->bitmapSizeX * 16, data->bitmapSizeY * 16};
 
     // fall back to image size / frames
-    int w, h;
-
-    SDL_QueryTexture(texture.get(), nullptr, nullptr, &w, &h);
-
-    return {w / data->totalFrames, h};
+    return {texture->width / data->totalFrames, texture->height};
 }
 
 float Object::getPixelX() const
 {
-    return pixelX;
+    return states->pixelX[state];
 }
 
 float Object::getPixelY() const
 {
-    return pixelY;
+    return states->pixelY[state];
 }
 
 void Object::setPixelPos(float x, float y)
 {
-    pixelX = x;
-    pixelY = y;
+    states->pixelX[state] = x;
+    states->pixelY[state] = y;
 }
 
-void Object::setTargetPos(int tx, int ty, int vx, int vy, bool reverse)
+void Object::setTargetPos(int tx, int ty, int vx, int vy, bool reverseDir)
 {
-    targetX = tx;
-    targetY = ty;
+    states->targetX[state] = tx;
+    states->targetY[state] = ty;
 
-    velX = vx;
-    velY = vy;
+    states->velX[state] = vx;
+    states->velY[state] = vy;
     
-    this->reverse = reverse;
+    states->reverse[state] = reverseDir;
 }
 
-void Object::startAnimation(int newId, SoundMixer &soundMix)
+// static objects won't change until something else modifies them
+// (so they can be cached)
+bool Object::isStatic() const
 {
-    currentAnimation = newId;
-    auto &newFrameset = data->framesets[currentAnimation];
-    currentAnimationFrame = newFrameset.startFrame;
+    if(!data || !texture)
+        return true;
 
-    if(newFrameset.soundId > 0 && soundReplayTimer <= 0 && (playingSoundId == ~0u || !soundMix.isSoundPlaying(playingSoundId)))
-    {
-        lastSound = soundMix.getLoader().loadSound(newFrameset.soundId);
-        if(lastSound)
-            playingSoundId = soundMix.playSound(lastSound, newFrameset.priority);
+    // pixel positioned/moving objects
+    if(data->bitmapOccupancy.empty() || states->velX[state] || states->velY[state])
+        return false;
 
-        if(newFrameset.replayDelay > 0)
-            soundReplayTimer = newFrameset.replayDelay * 1000;
-        else
-            soundReplayTimer = 0;
+    // alpha would be applied twice if drawn to an intermediate target
+    if(data->semiTransparent)
+        return false;
+
+    // about to start an animation
+    if(isAnimationPending())
+        return false;
+
+    // animation running
+    // (waiting for restartDelay is fine, that change will be picked up when it happens)
+    if(states->animationActive[state] && states->nextAnimation[state] == -1)
+    {
+        // ... unless it's a single frame that never changes
+        auto frameset = getCurrentFrameset();
+        return frameset && frameset->startFrame == frameset->endFrame
+            && (frameset->nextFrameSet == -1 || frameset->nextFrameSet == states->currentAnimation[state]);
     }
+
+    return true;
+}
+
+// plays the sound for an animation, unless the last one is still playing/waiting to replay
+void Object::playSound(const SoundRequest &request, SoundMixer &soundMix)
+{
+    if(request.time < soundReplayTime || (playingSoundId != ~0u && soundMix.isSoundPlaying(playingSoundId)))
+        return;
+
+    auto &frameset = data->framesets[request.frameset];
+
+    lastSound = soundMix.loadSound(frameset.soundId);
+    if(lastSound)
+        playingSoundId = soundMix.playSound(lastSound, frameset.priority);
+
+    // don't replay until this time
+    if(frameset.replayDelay > 0)
+        soundReplayTime = request.time + frameset.replayDelay * 1000;
+    else
+        soundReplayTime = 0;
+}
+
+void Object::startAnimation(int newId, uint64_t now, std::vector<SoundRequest> &sounds)
+{
+    states->currentAnimation[state] = newId;
+    auto &newFrameset = data->framesets[states->currentAnimation[state]];
+    states->animationFrame[state] = newFrameset.startFrame;
+
+    if(newFrameset.soundId > 0)
+        sounds.push_back({this, newId, now});
+}
+
+Object::State Object::getState() const
+{
+    // no uninitialised padding, states are compared as bytes
+    State ret;
+    memset(&ret, 0, sizeof(ret));
+
+    ret.x = x;
+    ret.y = y;
+    ret.serial = serial;
+
+    ret.currentAnimation = states->currentAnimation[state];
+    ret.nextAnimation = states->nextAnimation[state];
+    ret.animationFrame = states->animationFrame[state];
+    ret.animationActive = states->animationActive[state];
+    ret.animationSerial = states->animationSerial[state];
+
+    ret.pixelX = states->pixelX[state];
+    ret.pixelY = states->pixelY[state];
+    ret.lastPixelX = states->lastPixelX[state];
+    ret.lastPixelY = states->lastPixelY[state];
+    ret.targetX = states->targetX[state];
+    ret.targetY = states->targetY[state];
+    ret.velX = states->velX[state];
+    ret.velY = states->velY[state];
+    ret.reverse = states->reverse[state];
+
+    ret.animationTimer = animationTimer;
+    ret.localTime = localTime;
+    ret.soundReplayTime = soundReplayTime;
+    ret.playingSoundId = playingSoundId;
+
+    return ret;
+}
+
+void Object::setState(const State &newState)
+{
+    x = newState.x;
+    y = newState.y;
+    serial = newState.serial;
+
+    states->currentAnimation[state] = newState.currentAnimation;
+    states->nextAnimation[state] = newState.nextAnimation;
+    states->animationFrame[state] = newState.animationFrame;
+    states->animationActive[state] = newState.animationActive;
+    states->animationSerial[state] = newState.animationSerial;
+
+    states->pixelX[state] = newState.pixelX;
+    states->pixelY[state] = newState.pixelY;
+    states->lastPixelX[state] = newState.lastPixelX;
+    states->lastPixelY[state] = newState.lastPixelY;
+    states->targetX[state] = newState.targetX;
+    states->targetY[state] = newState.targetY;
+    states->velX[state] = newState.velX;
+    states->velY[state] = newState.velY;
+    states->reverse[state] = newState.reverse;
+
+    animationTimer = newState.animationTimer;
+    localTime = newState.localTime;
+    soundReplayTime = newState.soundReplayTime;
+    playingSoundId = newState.playingSoundId;
 }
@@ -9,6 +9,9 @@
 #include <vector>
 
 #include "ObjectData.hpp"
+#include "ObjectStates.hpp"
+#include "RenderSnapshot.hpp"
+#include "Renderer.hpp"
 
 class SoundMixer;
 
@@ -21,14 +24,70 @@ struct Minifig
 class Object
 {
 public:
-    Object(uint16_t id, uint16_t x, uint16_t y, std::string name, std::shared_ptr<SDL_Texture> texture, const ObjectData *data);
-
-    void update(uint32_t deltaMs, SoundMixer &soundMix);
-
-    void render(SDL_Renderer *renderer, int scrollX, int scrollY, int z, float zoom);
-    void renderDebug(SDL_Renderer *renderer, int scrollX, int scrollY, float zoom);
+    // everything that changes while running, for rewinding
+    // (id, name, minifigs are set when loading/creating)
+    struct State
+    {
+        int x, y;
+        uint32_t serial;
+
+        int32_t currentAnimation, nextAnimation;
+        int32_t animationFrame;
+        uint8_t animationActive;
+        uint32_t animationSerial;
+
+        float pixelX, pixelY;
+        float lastPixelX, lastPixelY;
+        float targetX, targetY;
+        float velX, velY;
+        uint8_t reverse;
+
+        int animationTimer;
+        uint64_t localTime;
+        uint64_t soundReplayTime;
+        uint32_t playingSoundId;
+    };
+
+    // an animation with a sound started
+    struct SoundRequest
+    {
+        Object *object;
+        int frameset;
+        uint64_t time;
+    };
+
+    Object(uint16_t id, uint16_t x, uint16_t y, std::string name, std::shared_ptr<Texture> texture, const ObjectData *data, ObjectStates &states);
+    Object(const Object &) = delete;
+    Object(Object &&other);
+    Object &operator=(const Object &) = delete;
+    Object &operator=(Object &&) = delete;
+    ~Object();
+
+    bool update(uint32_t deltaMs, SoundMixer &soundMix);
+
+    // remembers the position for interpolating between ticks
+    void beginTick();
+    void updateMotion(uint32_t deltaMs);
+    void checkTarget();
+    bool isMoving() const;
+
+    bool stepAnimation(uint64_t now, std::vector<SoundRequest> &sounds, int &nextDelay);
+    void playSound(const SoundRequest &request, SoundMixer &soundMix);
+    bool isAnimationPending() const;
+
+    // used to ignore old scheduled steps
+    uint32_t getAnimationSerial() const;
+    uint32_t newAnimationSerial();
+
+    RenderSnapshot::Sprite getSprite() const;
+    void renderDebug(Renderer &renderer, int scrollX, int scrollY, float zoom);
 
     uint16_t getId() const;
+    const std::string &getName() const;
+
+    // increases with each object created, for drawing in creation order
+    uint32_t getSerial() const;
+    void setSerial(uint32_t newSerial);
 
     int getX() const;
     int getY() const;
@@ -39,18 +98,18 @@ public:
 
     const ObjectData *getData() const;
 
-    void replace(uint16_t newId, std::shared_ptr<SDL_Texture> newTex = nullptr, const ObjectData *newData = nullptr);
+    void replace(uint16_t newId, std::shared_ptr<Texture> newTex = nullptr, const ObjectData *newData = nullptr);
 
     void addMinifig(Minifig &&minifig);
+    void setMinifigs(std::vector<Minifig> &&newMinifigs);
+    const std::vector<Minifig> &getMinifigs() const;
 
     const ObjectData::Frameset *getCurrentFrameset() const;
+    int getAnimation() const; // index, -1 if none
     int getFrameDelay() const;
 
-    void setDefaultAnimation();
-    bool setAnimation(int index);
-    bool setAnimation(std::string_view name);
-
     void setAnimationFrame(int frame);
+    int getAnimationFrame() const;
 
     std::tuple<int, int> getFrameSize() const;
 
@@ -61,32 +120,40 @@ public:
 
     void setTargetPos(int tx, int ty, int vx, int vy, bool reverse = false);
 
+    bool isStatic() const;
+
+    State getState() const;
+    void setState(const State &newState);
+
 private:
-    void startAnimation(int newId, SoundMixer &soundMix);
+    // changes need scheduling, so go through World::setObjectAnimation
+    friend class World;
+
+    void setDefaultAnimation();
+    bool setAnimation(int index);
+    bool setAnimation(std::string_view name);
+
+    void startAnimation(int newId, uint64_t now, std::vector<SoundRequest> &sounds);
 
     uint16_t id;
     int x, y;
     std::string name;
+    uint32_t serial = 0;
 
-    std::shared_ptr<SDL_Texture> texture;
+    std::shared_ptr<Texture> texture;
     const ObjectData *data;
 
     std::vector<Minifig> minifigs;
 
-    int currentAnimation = -1, nextAnimation = -1;
-    int currentAnimationFrame = 0;
+    // animation/position state
+    ObjectStates *states;
+    uint32_t state;
+
+    // only used by update()
     int animationTimer = 0;
+    uint64_t localTime = 0;
 
-    int soundReplayTimer = 0;
+    uint64_t soundReplayTime = 0;
     uint32_t playingSoundId = ~0u;
     std::shared_ptr<Mix_Chunk> lastSound;
-
-    // "screen" aligned objects
-    float pixelX = 0.0f, pixelY = 0.0f;
-
-    // moving objects
-    int targetX = 0, targetY = 0;
-    int velX = 0, velY = 0;
-
-    bool reverse = false;
 };
\ No newline at end of file
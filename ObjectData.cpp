@@ -1,5 +1,7 @@
+#include <algorithm>
 #include <cassert>
 #include <charconv>
+#include <cmath>
 #include <iostream>
 
 #include "ObjectData.hpp"
@@ -496,5 +498,141 @@ bool ObjectData::loadDatStream(std::istream &stream)
         
     }
 
+    buildOccupancyRects();
+    buildTrackPaths();
+
     return true;
-}
\ No newline at end of file
+}
+
+const ObjectData::TrackPath &ObjectData::getTrackPath(bool alternate) const
+{
+    return trackPaths[alternate ? 1 : 0];
+}
+
+void ObjectData::buildOccupancyRects()
+{
+    occupancyRects.clear();
+
+    if(bitmapOccupancy.empty())
+        return;
+
+    occupancyRects.resize(maxBitmapOccupancy + 1);
+
+    std::vector<bool> used(bitmapOccupancy.size());
+
+    auto getOccupancy = [this](unsigned int x, unsigned int y)
+    {
+        return bitmapOccupancy[x + y * bitmapSizeX];
+    };
+
+    // greedy: take the longest run in a row, then extend it down as far as possible
+    for(unsigned int y = 0; y < bitmapSizeY; y++)
+    {
+        for(unsigned int x = 0; x < bitmapSizeX; x++)
+        {
+            if(used[x + y * bitmapSizeX])
+                continue;
+
+            int value = getOccupancy(x, y);
+
+            if(value < 0)
+                continue;
+
+            unsigned int w = 1;
+            while(x + w < bitmapSizeX && !used[x + w + y * bitmapSizeX] && getOccupancy(x + w, y) == value)
+                w++;
+
+            unsigned int h = 1;
+            for(; y + h < bitmapSizeY; h++)
+            {
+                bool rowMatches = true;
+
+                for(unsigned int rx = x; rx < x + w && rowMatches; rx++)
+                    rowMatches = !used[rx + (y + h) * bitmapSizeX] && getOccupancy(rx, y + h) == value;
+
+                if(!rowMatches)
+                    break;
+            }
+
+            for(unsigned int ry = y; ry < y + h; ry++)
+            {
+                for(unsigned int rx = x; rx < x + w; rx++)
+                    used[rx + ry * bitmapSizeX] = true;
+            }
+
+            occupancyRects[value].push_back({int(x), int(y), int(w), int(h)});
+        }
+    }
+}
+
+void ObjectData::buildTrackPaths()
+{
+    for(int i = 0; i < 2; i++)
+    {
+        auto &inCoords = i ? altCoords : coords;
+        auto &path = trackPaths[i];
+
+        path = {};
+        path.x.reserve(inCoords.size());
+        path.y.reserve(inCoords.size());
+        path.dist.reserve(inCoords.size());
+
+        for(auto &coord : inCoords)
+        {
+            float x = std::get<0>(coord);
+            float y = std::get<1>(coord);
+
+            // coords are mostly a pixel apart, but diagonal steps are longer
+            if(!path.x.empty())
+                path.length += std::hypot(x - path.x.back(), y - path.y.back());
+
+            path.x.push_back(x);
+            path.y.push_back(y);
+            path.dist.push_back(path.length);
+        }
+    }
+}
+
+size_t ObjectData::TrackPath::getSegment(float pos) const
+{
+    if(dist.size() < 2)
+        return 0;
+
+    auto it = std::upper_bound(dist.begin() + 1, dist.end() - 1, pos);
+    return it - dist.begin() - 1;
+}
+
+void ObjectData::TrackPath::getPos(float pos, float &outX, float &outY) const
+{
+    if(x.empty())
+    {
+        outX = outY = 0.0f;
+        return;
+    }
+
+    auto segment = getSegment(pos);
+
+    outX = x[segment];
+    outY = y[segment];
+
+    if(segment + 1 == x.size())
+        return;
+
+    float segmentLength = dist[segment + 1] - dist[segment];
+
+    if(segmentLength <= 0.0f)
+        return;
+
+    float frac = (pos - dist[segment]) / segmentLength;
+
+    outX += (x[segment + 1] - x[segment]) * frac;
+    outY += (y[segment + 1] - y[segment]) * frac;
+}
+
+float ObjectData::TrackPath::getFirstSegmentLength(bool reverse) const
+{
+    if(dist.size() < 2)
+        return 0.0f;
+
+    return reverse ? length - dist[dist.size() - 2] : dist[1];
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <istream>
+#include <tuple>
 #include <vector>
 
 class ObjectData final
@@ -41,6 +42,29 @@ public:
         int x = 0, y = 0; // for the new object
     };
 
+    // rect of tiles with the same occupancy value
+    struct TileRect
+    {
+        int x, y, w, h;
+    };
+
+    // track coords compiled for moving along by distance
+    struct TrackPath
+    {
+        std::vector<float> x, y;
+        std::vector<float> dist; // to each coord from the first
+        float length = 0.0f;
+
+        // segment containing pos, the first/last if outside the path
+        size_t getSegment(float pos) const;
+
+        // relative to the object, extrapolated past the ends
+        void getPos(float pos, float &outX, float &outY) const;
+
+        // the segment that overlaps the previous object when entering from that end
+        float getFirstSegmentLength(bool reverse) const;
+    };
+
     struct Frameset
     {
         std::string name;
@@ -90,6 +114,10 @@ public:
     int maxBitmapOccupancy = 0;
     std::vector<int> bitmapOccupancy; // TODO: not a bitmap, but values are small
 
+    // bitmapOccupancy merged into rects, indexed by occupancy value
+    // (0 is included for the second layer of split frames)
+    std::vector<std::vector<TileRect>> occupancyRects;
+
     bool semiTransparent = false;
 
     int entryExitOffsets[4] = {0, 0, 0, 0}; // offsets along edges?
@@ -98,6 +126,7 @@ public:
 
     // used for track pieces, second list is used for points and crossings
     std::vector<std::tuple<int, int>> coords, altCoords;
+    TrackPath trackPaths[2]; // built from coords, altCoords
 
     int rmbSeq = -1; // next object when pressing right mouse button while placing?
 
@@ -129,4 +158,10 @@ public:
     // (e.g. "bridge horizontal", "depot top")
     SpecialType specialType = SpecialType::None;
     SpecialSide specialSide = SpecialSide::None;
+
+    const TrackPath &getTrackPath(bool alternate) const;
+
+private:
+    void buildOccupancyRects();
+    void buildTrackPaths();
 };
\ No newline at end of file
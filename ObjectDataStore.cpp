@@ -13,10 +13,14 @@ const ObjectData *ObjectDataStore::getObject(int32_t id)
         return nullptr;
 
     // find existing
-    auto it = data.find(id);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto it = data.find(id);
 
-    if(it != data.end())
-        return &it->second;
+        if(it != data.end())
+            return &it->second;
+    }
 
     // try to load
     auto stream = fileLoader.openResourceFile(id, ".dat");
@@ -35,18 +39,22 @@ const ObjectData *ObjectDataStore::getObject(int32_t id)
         return nullptr;
     }
 
-    return &data.emplace(id, objDat).first->second;
+    // returns the existing data if another thread loaded it first
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return &data.emplace(id, std::move(objDat)).first->second;
 }
 
 const ObjectDataStore::TrainData &ObjectDataStore::getTrainData()
 {
-    if(trainData.empty())
+    // called for every train part every tick, so avoid the lock once loaded
+    std::call_once(trainDataOnce, [this]
     {
         // 6146 == trains/train
         auto stream = fileLoader.openResourceFile(6146, ".dat");
 
         if(!stream)
-            return trainData;
+            return;
 
         std::string line;
         while(std::getline(*stream >> std::ws, line))
@@ -76,7 +84,7 @@ const ObjectDataStore::TrainData &ObjectDataStore::getTrainData()
             trainData.emplace_back(vals[0], vals[1], vals[2], vals[3]);
         }
         std::cout.flush();
-    }
+    });
 
     return trainData;
 }
@@ -2,12 +2,14 @@
 
 #include <cstdint>
 #include <map>
+#include <mutex>
 
 #include "FileLoader.hpp"
 #include "ObjectData.hpp"
 
 // stores object data
 // this is the best name I could come up with...
+// (data is never unloaded, so pointers stay valid)
 class ObjectDataStore final
 {
 public:
@@ -22,8 +24,10 @@ public:
 private:
     FileLoader &fileLoader;
 
+    std::mutex mutex;
     std::map<int32_t, ObjectData> data;
 
     // list of two pairs of coords from train.dat
+    std::once_flag trainDataOnce;
     TrainData trainData;
 };
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include <limits>
+
+#include "ObjectStates.hpp"
+
+// new objects have no previous position until the next tick
+static const float noPosition = std::numeric_limits<float>::quiet_NaN();
+
+uint32_t ObjectStates::allocate()
+{
+    uint32_t index;
+
+    if(!freeIndices.empty())
+    {
+        index = freeIndices.back();
+        freeIndices.pop_back();
+    }
+    else
+    {
+        index = pixelX.size();
+
+        currentAnimation.push_back(-1);
+        nextAnimation.push_back(-1);
+        animationFrame.push_back(0);
+        animationActive.push_back(0);
+        animationSerial.push_back(0);
+
+        pixelX.push_back(0.0f);
+        pixelY.push_back(0.0f);
+        lastPixelX.push_back(noPosition);
+        lastPixelY.push_back(noPosition);
+
+        targetX.push_back(0.0f);
+        targetY.push_back(0.0f);
+        velX.push_back(0.0f);
+        velY.push_back(0.0f);
+        reverse.push_back(0);
+
+        return index;
+    }
+
+    // reset
+    currentAnimation[index] = -1;
+    nextAnimation[index] = -1;
+    animationFrame[index] = 0;
+    animationActive[index] = 0;
+    // serial is kept so that old timers stay invalid
+
+    pixelX[index] = pixelY[index] = 0.0f;
+    lastPixelX[index] = lastPixelY[index] = noPosition;
+
+    targetX[index] = targetY[index] = 0.0f;
+    velX[index] = velY[index] = 0.0f;
+    reverse[index] = 0;
+
+    return index;
+}
+
+void ObjectStates::release(uint32_t index)
+{
+    // stop it moving
+    velX[index] = velY[index] = 0.0f;
+
+    freeIndices.push_back(index);
+}
+
+void ObjectStates::reserve(std::size_t size)
+{
+    currentAnimation.reserve(size);
+    nextAnimation.reserve(size);
+    animationFrame.reserve(size);
+    animationActive.reserve(size);
+    animationSerial.reserve(size);
+
+    pixelX.reserve(size);
+    pixelY.reserve(size);
+    lastPixelX.reserve(size);
+    lastPixelY.reserve(size);
+
+    targetX.reserve(size);
+    targetY.reserve(size);
+    velX.reserve(size);
+    velY.reserve(size);
+    reverse.reserve(size);
+}
+
+bool ObjectStates::hasArrived(uint32_t index) const
+{
+    return (velX[index] > 0 && pixelX[index] >= targetX[index])
+        || (velX[index] < 0 && pixelX[index] <= targetX[index])
+        || (velY[index] > 0 && pixelY[index] >= targetY[index])
+        || (velY[index] < 0 && pixelY[index] <= targetY[index]);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// frequently updated object state, stored as arrays instead of in each Object
+// (Object keeps an index into these)
+class ObjectStates final
+{
+public:
+    uint32_t allocate();
+    void release(uint32_t index);
+
+    // for loading lots of objects at once
+    void reserve(std::size_t size);
+
+    bool hasArrived(uint32_t index) const;
+
+    // animation
+    std::vector<int32_t> currentAnimation, nextAnimation;
+    std::vector<int32_t> animationFrame;
+    std::vector<uint8_t> animationActive; // running or waiting for restartDelay
+    std::vector<uint32_t> animationSerial;
+
+    // "screen" aligned objects
+    std::vector<float> pixelX, pixelY;
+    std::vector<float> lastPixelX, lastPixelY; // at the start of the tick
+
+    // moving objects
+    std::vector<float> targetX, targetY;
+    std::vector<float> velX, velY;
+    std::vector<uint8_t> reverse;
+
+private:
+    std::vector<uint32_t> freeIndices;
+};
@@ -0,0 +1,119 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "Recording.hpp"
+
+// "BTRC" + version, everything else is in native byte order
+static const char magic[4] = {'B', 'T', 'R', 'C'};
+static const uint32_t version = 1;
+
+template<class T>
+static bool readValue(std::istream &stream, T &value)
+{
+    return stream.read(reinterpret_cast<char *>(&value), sizeof(T)).gcount() == sizeof(T);
+}
+
+template<class T>
+static void writeValue(std::ostream &stream, const T &value)
+{
+    stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+}
+
+bool Recording::load(const std::filesystem::path &path)
+{
+    std::ifstream file(path, std::ios::binary);
+
+    if(!file)
+    {
+        std::cerr << "Failed to open " << path << "\n";
+        return false;
+    }
+
+    char fileMagic[4];
+    uint32_t fileVersion, eventSize;
+    uint64_t numEvents;
+
+    if(!readValue(file, fileMagic) || memcmp(fileMagic, magic, 4) != 0 || !readValue(file, fileVersion) || fileVersion != version)
+    {
+        std::cerr << path << " is not a recording\n";
+        return false;
+    }
+
+    // SDL_Event is stored as-is
+    if(!readValue(file, eventSize) || eventSize != sizeof(SDL_Event))
+    {
+        std::cerr << path << " was recorded with a different SDL\n";
+        return false;
+    }
+
+    if(!readValue(file, randomSeed) || !readValue(file, dateTime) || !readValue(file, length) || !readValue(file, numEvents))
+    {
+        std::cerr << "Failed to read header for " << path << "\n";
+        return false;
+    }
+
+    // don't trust the count until we know the events are there
+    auto dataStart = file.tellg();
+    file.seekg(0, std::ios::end);
+    uint64_t remaining = file.tellg() - dataStart;
+    file.seekg(dataStart);
+
+    if(numEvents > remaining / (sizeof(Event::tick) + sizeof(SDL_Event)))
+    {
+        std::cerr << "Failed to read events for " << path << "\n";
+        return false;
+    }
+
+    events.clear();
+    events.reserve(numEvents);
+
+    for(uint64_t i = 0; i < numEvents; i++)
+    {
+        Event event;
+
+        if(!readValue(file, event.tick) || !readValue(file, event.event))
+        {
+            std::cerr << "Failed to read events for " << path << "\n";
+            return false;
+        }
+
+        events.push_back(event);
+    }
+
+    return true;
+}
+
+bool Recording::save(const std::filesystem::path &path) const
+{
+    std::ofstream file(path, std::ios::binary);
+
+    if(!file)
+    {
+        std::cerr << "Failed to open " << path << " for writing\n";
+        return false;
+    }
+
+    file.write(magic, 4);
+    writeValue(file, version);
+    writeValue(file, uint32_t(sizeof(SDL_Event)));
+
+    writeValue(file, randomSeed);
+    writeValue(file, dateTime);
+    writeValue(file, length);
+    writeValue(file, uint64_t(events.size()));
+
+    for(auto &event : events)
+    {
+        writeValue(file, event.tick);
+        writeValue(file, event.event);
+    }
+
+    if(!file)
+    {
+        std::cerr << "Failed to write " << path << "\n";
+        return false;
+    }
+
+    return true;
+}
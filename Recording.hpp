@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include <SDL.h>
+
+// everything from outside that affects the simulation, enough to replay a session exactly
+class Recording final
+{
+public:
+    struct Event
+    {
+        uint64_t tick; // ticks run before it was handled
+        SDL_Event event;
+    };
+
+    bool load(const std::filesystem::path &path);
+    bool save(const std::filesystem::path &path) const;
+
+    uint32_t randomSeed = 0;
+    int64_t dateTime = 0; // World::getDateTime before loading the save
+    uint64_t length = 0; // in ticks
+
+    std::vector<Event> events;
+};
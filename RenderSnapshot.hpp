@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ObjectData.hpp"
+#include "Texture.hpp"
+
+// everything needed to draw the world, copied out after a simulation tick
+// the render thread only reads these, so the world can keep updating
+struct RenderSnapshot
+{
+    // an object as it was at the end of the tick
+    struct Sprite
+    {
+        std::shared_ptr<Texture> texture;
+        const ObjectData *data;
+        const ObjectData::Frameset *frameset;
+        int frame;
+
+        int x, y; // in tiles
+        float pixelX, pixelY;
+        float lastPixelX, lastPixelY; // at the start of the tick
+
+        bool isStatic;
+
+        uint32_t order = 0; // objects are drawn in this order (creation serial)
+    };
+
+    // both sorted by order
+    // static objects only change along with the chunk versions, so the list is shared until one does
+    std::shared_ptr<const std::vector<Sprite>> staticObjects;
+    std::vector<Sprite> dynamicObjects;
+    std::vector<Sprite> trainParts; // in drawing order
+
+    uint16_t width = 0, height = 0;
+    std::shared_ptr<Texture> backdrop;
+
+    int scrollX = 0, scrollY = 0;
+    float zoom = 1.0f;
+    unsigned int windowWidth = 0, windowHeight = 0;
+
+    // changes whenever a static object in the chunk does
+    unsigned int chunksX = 0, chunksY = 0;
+    std::vector<uint32_t> chunkVersions;
+
+    // something moved during the tick, so is worth interpolating
+    bool moving = false;
+
+    // when the tick finished and how much real time it covers (0 if not interpolating)
+    std::chrono::steady_clock::time_point time;
+    std::chrono::steady_clock::duration tickLength{0};
+};
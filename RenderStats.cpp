@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <iostream>
+
+#include "RenderStats.hpp"
+
+RenderStats::RenderStats(std::unique_ptr<Renderer> renderer) : renderer(std::move(renderer))
+{
+}
+
+std::shared_ptr<Texture> RenderStats::createTexture(SDL_Surface *surface)
+{
+    return renderer->createTexture(surface);
+}
+
+void RenderStats::uploadTexture(const Texture &texture)
+{
+    renderer->uploadTexture(texture);
+}
+
+bool RenderStats::getTargetsSupported() const
+{
+    return renderer->getTargetsSupported();
+}
+
+std::shared_ptr<Texture> RenderStats::createTarget(int width, int height)
+{
+    return renderer->createTarget(width, height);
+}
+
+void RenderStats::setTarget(std::shared_ptr<Texture> target)
+{
+    renderer->setTarget(std::move(target));
+
+    // clip rect is reset by the change
+    renderer->getClipRect(clipRect);
+}
+
+std::shared_ptr<Texture> RenderStats::getTarget() const
+{
+    return renderer->getTarget();
+}
+
+void RenderStats::setClipRect(const SDL_Rect *rect)
+{
+    renderer->setClipRect(rect);
+    renderer->getClipRect(clipRect);
+}
+
+void RenderStats::getClipRect(SDL_Rect &rect) const
+{
+    renderer->getClipRect(rect);
+}
+
+void RenderStats::setDrawColour(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    drawColour[0] = r;
+    drawColour[1] = g;
+    drawColour[2] = b;
+    drawColour[3] = a;
+
+    renderer->setDrawColour(r, g, b, a);
+}
+
+void RenderStats::clear()
+{
+    current.drawCalls++;
+    renderer->clear();
+}
+
+void RenderStats::drawPoint(int x, int y)
+{
+    current.drawCalls++;
+    renderer->drawPoint(x, y);
+}
+
+void RenderStats::drawRect(const SDL_Rect &rect)
+{
+    current.drawCalls++;
+    renderer->drawRect(rect);
+}
+
+void RenderStats::fillRect(const SDL_Rect &rect)
+{
+    current.drawCalls++;
+    renderer->fillRect(rect);
+}
+
+void RenderStats::copy(const Texture &texture, const SDL_Rect *srcRect, const SDL_Rect *dstRect, bool flipX)
+{
+    current.drawCalls++;
+
+    if(&texture != lastTexture)
+    {
+        current.textureSwitches++;
+        lastTexture = &texture;
+    }
+
+    // count what ends up inside the clip rect
+    SDL_Rect dst = dstRect ? *dstRect : SDL_Rect{0, 0, texture.width, texture.height};
+    SDL_Rect area;
+
+    if(!clipRect.w || !clipRect.h)
+        area = dst;
+    else if(!SDL_IntersectRect(&dst, &clipRect, &area))
+        area = {0, 0, 0, 0};
+
+    current.pixelsCopied += std::max(0, area.w) * std::max(0, area.h);
+
+    if(objectPending)
+    {
+        current.objectsDrawn++;
+        objectPending = false;
+    }
+
+    renderer->copy(texture, srcRect, dstRect, flipX);
+}
+
+void RenderStats::present()
+{
+    if(overlayEnabled)
+        drawOverlay();
+
+    renderer->present();
+
+    endFrame();
+}
+
+void RenderStats::beginObject()
+{
+    current.objectsVisited++;
+    objectPending = true;
+}
+
+RenderStats::Counts RenderStats::getAverage() const
+{
+    if(!historyCount)
+        return {};
+
+    Counts ret;
+    ret.drawCalls = totals.drawCalls / historyCount;
+    ret.textureSwitches = totals.textureSwitches / historyCount;
+    ret.pixelsCopied = totals.pixelsCopied / historyCount;
+    ret.objectsVisited = totals.objectsVisited / historyCount;
+    ret.objectsDrawn = totals.objectsDrawn / historyCount;
+
+    return ret;
+}
+
+void RenderStats::setOverlayEnabled(bool enabled)
+{
+    overlayEnabled = enabled;
+}
+
+bool RenderStats::getOverlayEnabled() const
+{
+    return overlayEnabled;
+}
+
+void RenderStats::setLogEnabled(bool enabled)
+{
+    logEnabled = enabled;
+}
+
+void RenderStats::endFrame()
+{
+    // replace the oldest frame in the running totals
+    auto &old = history[historyIndex];
+
+    totals.drawCalls += current.drawCalls - old.drawCalls;
+    totals.textureSwitches += current.textureSwitches - old.textureSwitches;
+    totals.pixelsCopied += current.pixelsCopied - old.pixelsCopied;
+    totals.objectsVisited += current.objectsVisited - old.objectsVisited;
+    totals.objectsDrawn += current.objectsDrawn - old.objectsDrawn;
+
+    old = current;
+
+    historyIndex = (historyIndex + 1) % numFrames;
+    historyCount = std::min(historyCount + 1, numFrames);
+
+    current = {};
+    lastTexture = nullptr;
+    objectPending = false;
+
+    if(logEnabled && historyIndex == 0)
+    {
+        auto avg = getAverage();
+        std::cout << "render: " << avg.drawCalls << " draws, " << avg.textureSwitches << " texture switches, "
+                  << avg.pixelsCopied << " pixels, " << avg.objectsDrawn << "/" << avg.objectsVisited << " objects drawn" << std::endl;
+    }
+}
+
+// graph of recent frames, one row per counter
+void RenderStats::drawOverlay()
+{
+    const int graphHeight = 32;
+    const int margin = 4;
+
+    static const uint8_t colours[][3]{
+        {255, 255, 255}, // draw calls
+        {255, 255, 0}, // texture switches
+        {0, 255, 255}, // pixels
+        {255, 0, 255}, // objects visited
+        {0, 255, 0}, // objects drawn
+    };
+
+    auto getValue = [](const Counts &counts, int row) -> uint64_t
+    {
+        switch(row)
+        {
+            case 0: return counts.drawCalls;
+            case 1: return counts.textureSwitches;
+            case 2: return counts.pixelsCopied;
+            case 3: return counts.objectsVisited;
+            default: return counts.objectsDrawn;
+        }
+    };
+
+    // draw directly to the output, without counting anything
+    auto oldTarget = renderer->getTarget();
+    renderer->setTarget(nullptr);
+
+    SDL_Rect oldClip;
+    renderer->getClipRect(oldClip);
+    renderer->setClipRect(nullptr);
+
+    // visited/drawn share a scale
+    uint64_t maxValue[5]{};
+
+    for(int i = 0; i < historyCount; i++)
+    {
+        for(int row = 0; row < 5; row++)
+            maxValue[row] = std::max(maxValue[row], getValue(history[i], row));
+    }
+
+    maxValue[4] = maxValue[3] = std::max(maxValue[3], maxValue[4]);
+
+    for(int row = 0; row < 5; row++)
+    {
+        // visited/drawn are drawn on top of each other
+        int graphY = margin + std::min(row, 3) * (graphHeight + margin);
+
+        renderer->setDrawColour(0, 0, 0, 255);
+        renderer->drawRect({margin - 1, graphY - 1, numFrames * 2 + 2, graphHeight + 2});
+
+        renderer->setDrawColour(colours[row][0], colours[row][1], colours[row][2], 255);
+
+        if(!maxValue[row])
+            continue;
+
+        // oldest on the left
+        for(int i = 0; i < historyCount; i++)
+        {
+            int index = (historyIndex - historyCount + i + numFrames) % numFrames;
+            int h = static_cast<int>(getValue(history[index], row) * graphHeight / maxValue[row]);
+
+            if(h)
+                renderer->drawRect({margin + i * 2, graphY + graphHeight - h, 1, h});
+        }
+    }
+
+    renderer->setDrawColour(drawColour[0], drawColour[1], drawColour[2], drawColour[3]);
+    renderer->setTarget(oldTarget);
+    renderer->setClipRect(&oldClip);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "Renderer.hpp"
+
+// wraps another renderer and counts what gets drawn
+class RenderStats final : public Renderer
+{
+public:
+    struct Counts
+    {
+        uint64_t drawCalls = 0;
+        uint64_t textureSwitches = 0;
+        uint64_t pixelsCopied = 0;
+        uint64_t objectsVisited = 0;
+        uint64_t objectsDrawn = 0;
+    };
+
+    RenderStats(std::unique_ptr<Renderer> renderer);
+
+    std::shared_ptr<Texture> createTexture(SDL_Surface *surface) override;
+    void uploadTexture(const Texture &texture) override;
+
+    bool getTargetsSupported() const override;
+    std::shared_ptr<Texture> createTarget(int width, int height) override;
+    void setTarget(std::shared_ptr<Texture> target) override;
+    std::shared_ptr<Texture> getTarget() const override;
+
+    void setClipRect(const SDL_Rect *rect) override;
+    void getClipRect(SDL_Rect &rect) const override;
+
+    void setDrawColour(uint8_t r, uint8_t g, uint8_t b, uint8_t a) override;
+
+    void clear() override;
+    void drawPoint(int x, int y) override;
+    void drawRect(const SDL_Rect &rect) override;
+    void fillRect(const SDL_Rect &rect) override;
+
+    void copy(const Texture &texture, const SDL_Rect *srcRect, const SDL_Rect *dstRect, bool flipX = false) override;
+
+    void present() override;
+
+    void beginObject() override;
+
+    // averages over the last numFrames presented frames
+    Counts getAverage() const;
+
+    void setOverlayEnabled(bool enabled);
+    bool getOverlayEnabled() const;
+
+    void setLogEnabled(bool enabled);
+
+private:
+    static const int numFrames = 60;
+
+    void endFrame();
+    void drawOverlay();
+
+    std::unique_ptr<Renderer> renderer;
+
+    Counts current;
+    Counts history[numFrames];
+    Counts totals;
+    int historyIndex = 0, historyCount = 0;
+
+    const Texture *lastTexture = nullptr;
+    bool objectPending = false;
+
+    SDL_Rect clipRect{0, 0, 0, 0};
+    uint8_t drawColour[4]{0, 0, 0, 255};
+
+    bool overlayEnabled = false;
+    bool logEnabled = false;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <SDL.h>
+
+#include "Texture.hpp"
+
+// interface for the different ways of drawing the world
+class Renderer
+{
+public:
+    virtual ~Renderer() = default;
+
+    // does not take ownership of the surface
+    // can be called from any thread (while nothing else is creating textures)
+    virtual std::shared_ptr<Texture> createTexture(SDL_Surface *surface) = 0;
+
+    // uploads a texture now instead of when it's first drawn, render thread only
+    virtual void uploadTexture(const Texture &texture) {}
+
+    // render targets (may be unsupported)
+    // clip rect is reset when changing target, same as SDL
+    virtual bool getTargetsSupported() const = 0;
+    virtual std::shared_ptr<Texture> createTarget(int width, int height) = 0;
+    virtual void setTarget(std::shared_ptr<Texture> target) = 0; // nullptr for the output
+    virtual std::shared_ptr<Texture> getTarget() const = 0;
+
+    // null or empty rect disables clipping
+    virtual void setClipRect(const SDL_Rect *rect) = 0;
+    virtual void getClipRect(SDL_Rect &rect) const = 0;
+
+    virtual void setDrawColour(uint8_t r, uint8_t g, uint8_t b, uint8_t a) = 0;
+
+    virtual void clear() = 0;
+    virtual void drawPoint(int x, int y) = 0;
+    virtual void drawRect(const SDL_Rect &rect) = 0; // outline
+    virtual void fillRect(const SDL_Rect &rect) = 0;
+
+    virtual void copy(const Texture &texture, const SDL_Rect *srcRect, const SDL_Rect *dstRect, bool flipX = false) = 0;
+
+    virtual void present() = 0;
+
+    // called before drawing each object, only used for stats
+    virtual void beginObject() {}
+};
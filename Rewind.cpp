@@ -0,0 +1,229 @@
+#include <algorithm>
+
+#include "Rewind.hpp"
+
+// don't split a changed run for fewer unchanged bytes than this
+static const size_t minUnchangedRun = 8;
+
+static void writeVarint(std::vector<uint8_t> &out, size_t value)
+{
+    while(value >= 0x80)
+    {
+        out.push_back(uint8_t(value | 0x80));
+        value >>= 7;
+    }
+
+    out.push_back(uint8_t(value));
+}
+
+static bool readVarint(const uint8_t *&ptr, const uint8_t *end, size_t &value)
+{
+    value = 0;
+
+    for(int shift = 0; ptr != end && shift < 64; shift += 7)
+    {
+        auto byte = *ptr++;
+        value |= size_t(byte & 0x7F) << shift;
+
+        if(!(byte & 0x80))
+            return true;
+    }
+
+    return false;
+}
+
+RewindBuffer::RewindBuffer(size_t maxStates, unsigned int keyframeInterval) : maxStates(maxStates), keyframeInterval(std::max(1u, keyframeInterval))
+{
+}
+
+void RewindBuffer::setLimits(size_t maxStates, unsigned int keyframeInterval)
+{
+    this->maxStates = maxStates;
+    this->keyframeInterval = std::max(1u, keyframeInterval);
+}
+
+void RewindBuffer::push(uint64_t tick, const std::vector<uint8_t> &state)
+{
+    Entry entry;
+    entry.tick = tick;
+    entry.keyframe = entries.empty() || entries.size() - lastKeyframe >= keyframeInterval;
+
+    if(entry.keyframe)
+        entry.data = state;
+    else
+        encodeDelta(entries[lastKeyframe].data, state, entry.data);
+
+    memoryUsage += entry.data.size();
+    entries.push_back(std::move(entry));
+
+    if(entries.back().keyframe)
+        lastKeyframe = entries.size() - 1;
+
+    // deltas can't outlive their keyframe, so this drops a whole group at a time
+    // (and never the one being added to)
+    while(maxStates && entries.size() > maxStates && lastKeyframe > 0)
+    {
+        do
+            popFront();
+        while(!entries.front().keyframe);
+    }
+}
+
+bool RewindBuffer::get(uint64_t tick, std::vector<uint8_t> &state, uint64_t &stateTick) const
+{
+    auto it = std::upper_bound(entries.begin(), entries.end(), tick, [](uint64_t tick, const Entry &entry){return tick < entry.tick;});
+
+    if(it == entries.begin())
+        return false;
+
+    --it;
+    stateTick = it->tick;
+
+    if(it->keyframe)
+    {
+        state = it->data;
+        return true;
+    }
+
+    // find the keyframe it's based on
+    auto keyframe = it;
+    while(!keyframe->keyframe)
+        --keyframe;
+
+    return decodeDelta(keyframe->data, it->data, state);
+}
+
+void RewindBuffer::truncate(uint64_t tick)
+{
+    while(!entries.empty() && entries.back().tick > tick)
+    {
+        memoryUsage -= entries.back().data.size();
+        entries.pop_back();
+    }
+
+    lastKeyframe = entries.empty() ? 0 : entries.size() - 1;
+
+    while(lastKeyframe > 0 && !entries[lastKeyframe].keyframe)
+        lastKeyframe--;
+}
+
+void RewindBuffer::clear()
+{
+    entries.clear();
+    lastKeyframe = 0;
+    memoryUsage = 0;
+}
+
+bool RewindBuffer::empty() const
+{
+    return entries.empty();
+}
+
+size_t RewindBuffer::size() const
+{
+    return entries.size();
+}
+
+uint64_t RewindBuffer::getOldestTick() const
+{
+    return entries.empty() ? 0 : entries.front().tick;
+}
+
+uint64_t RewindBuffer::getNewestTick() const
+{
+    return entries.empty() ? 0 : entries.back().tick;
+}
+
+size_t RewindBuffer::getMemoryUsage() const
+{
+    return memoryUsage;
+}
+
+// format: state size, then pairs of (unchanged count, changed count, changed bytes)
+// anything past the end of the base counts as changed
+void RewindBuffer::encodeDelta(const std::vector<uint8_t> &base, const std::vector<uint8_t> &state, std::vector<uint8_t> &delta)
+{
+    delta.clear();
+    writeVarint(delta, state.size());
+
+    auto size = state.size();
+    auto baseSize = std::min(size, base.size());
+
+    size_t i = 0;
+
+    while(i < size)
+    {
+        auto unchangedStart = i;
+
+        while(i < baseSize && state[i] == base[i])
+            i++;
+
+        auto changedStart = i;
+
+        while(i < size)
+        {
+            if(i < baseSize && state[i] == base[i])
+            {
+                // end the run if enough is unchanged (or the rest is)
+                auto j = i;
+                while(j < baseSize && state[j] == base[j] && j - i < minUnchangedRun)
+                    j++;
+
+                if(j - i == minUnchangedRun || j == size)
+                    break;
+
+                i = j;
+            }
+            else
+                i++;
+        }
+
+        writeVarint(delta, changedStart - unchangedStart);
+        writeVarint(delta, i - changedStart);
+        delta.insert(delta.end(), state.begin() + changedStart, state.begin() + i);
+    }
+}
+
+bool RewindBuffer::decodeDelta(const std::vector<uint8_t> &base, const std::vector<uint8_t> &delta, std::vector<uint8_t> &state)
+{
+    auto ptr = delta.data();
+    auto end = ptr + delta.size();
+
+    size_t size;
+
+    if(!readVarint(ptr, end, size))
+        return false;
+
+    state.resize(size);
+
+    auto baseSize = std::min(size, base.size());
+
+    size_t i = 0;
+
+    while(i < size)
+    {
+        size_t unchanged, changed;
+
+        if(!readVarint(ptr, end, unchanged) || !readVarint(ptr, end, changed))
+            return false;
+
+        if((!unchanged && !changed) || unchanged > (i < baseSize ? baseSize - i : 0) || changed > size - i - unchanged || changed > size_t(end - ptr))
+            return false;
+
+        std::copy(base.begin() + i, base.begin() + i + unchanged, state.begin() + i);
+        i += unchanged;
+
+        std::copy(ptr, ptr + changed, state.begin() + i);
+        ptr += changed;
+        i += changed;
+    }
+
+    return ptr == end;
+}
+
+void RewindBuffer::popFront()
+{
+    memoryUsage -= entries.front().data.size();
+    entries.pop_front();
+    lastKeyframe--;
+}
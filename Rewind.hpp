@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// ring buffer of world states (see World::saveState) for rewinding
+// every keyframeInterval'th state is stored whole, the rest as a delta against the last keyframe
+class RewindBuffer final
+{
+public:
+    RewindBuffer(size_t maxStates = 0, unsigned int keyframeInterval = 30);
+
+    // 0 states keeps everything
+    void setLimits(size_t maxStates, unsigned int keyframeInterval);
+
+    // ticks should increase, the oldest states are dropped when full
+    void push(uint64_t tick, const std::vector<uint8_t> &state);
+
+    // the newest state at or before tick, false if there isn't one
+    bool get(uint64_t tick, std::vector<uint8_t> &state, uint64_t &stateTick) const;
+
+    // drops anything newer than tick (after rewinding to it)
+    void truncate(uint64_t tick);
+
+    void clear();
+
+    bool empty() const;
+    size_t size() const;
+
+    uint64_t getOldestTick() const;
+    uint64_t getNewestTick() const;
+
+    // in bytes, not counting the deque itself
+    size_t getMemoryUsage() const;
+
+private:
+    struct Entry
+    {
+        uint64_t tick;
+        bool keyframe;
+        std::vector<uint8_t> data;
+    };
+
+    // runs of unchanged/changed bytes
+    static void encodeDelta(const std::vector<uint8_t> &base, const std::vector<uint8_t> &state, std::vector<uint8_t> &delta);
+    static bool decodeDelta(const std::vector<uint8_t> &base, const std::vector<uint8_t> &delta, std::vector<uint8_t> &state);
+
+    void popFront();
+
+    size_t maxStates;
+    unsigned int keyframeInterval;
+
+    std::deque<Entry> entries;
+    size_t lastKeyframe = 0; // index into entries
+
+    size_t memoryUsage = 0;
+};
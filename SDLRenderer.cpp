@@ -0,0 +1,157 @@
+#include <iostream>
+
+#include "SDLRenderer.hpp"
+
+SDLRenderer::SDLRenderer(SDL_Renderer *renderer) : renderer(renderer)
+{
+}
+
+std::shared_ptr<Texture> SDLRenderer::createTexture(SDL_Surface *surface)
+{
+    SDL_Surface *converted = nullptr;
+
+    // indexed bitmaps use index 0 as transparent
+    // TODO: is this always true?
+    if(SDL_PIXELTYPE(surface->format->format) == SDL_PIXELTYPE_INDEX8)
+    {
+        // set index 0 to transparent and convert to RGBA
+        SDL_Colour trans{0, 0, 0, 0};
+        SDL_SetPaletteColors(surface->format->palette, &trans, 0, 1);
+
+        converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+
+        if(!converted)
+            return nullptr;
+
+        surface = converted;
+    }
+
+    // this may not be the render thread, so keep a copy to upload when it's first drawn
+    if(!converted)
+    {
+        converted = SDL_DuplicateSurface(surface);
+
+        if(!converted)
+            return nullptr;
+    }
+
+    auto texture = std::make_shared<Texture>();
+    texture->width = converted->w;
+    texture->height = converted->h;
+    texture->surface = std::shared_ptr<SDL_Surface>(converted, SDL_FreeSurface);
+
+    return texture;
+}
+
+void SDLRenderer::uploadTexture(const Texture &texture)
+{
+    getSDLTexture(texture);
+}
+
+bool SDLRenderer::getTargetsSupported() const
+{
+    return SDL_RenderTargetSupported(renderer);
+}
+
+std::shared_ptr<Texture> SDLRenderer::createTarget(int width, int height)
+{
+    auto sdlTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_TARGET, width, height);
+
+    if(!sdlTexture)
+        return nullptr;
+
+    SDL_SetTextureBlendMode(sdlTexture, SDL_BLENDMODE_BLEND);
+
+    auto texture = std::make_shared<Texture>();
+    texture->width = width;
+    texture->height = height;
+    texture->sdlTexture = std::shared_ptr<SDL_Texture>(sdlTexture, SDL_DestroyTexture);
+
+    return texture;
+}
+
+void SDLRenderer::setTarget(std::shared_ptr<Texture> target)
+{
+    this->target = std::move(target);
+    SDL_SetRenderTarget(renderer, this->target ? this->target->sdlTexture.get() : nullptr);
+}
+
+std::shared_ptr<Texture> SDLRenderer::getTarget() const
+{
+    return target;
+}
+
+void SDLRenderer::setClipRect(const SDL_Rect *rect)
+{
+    SDL_RenderSetClipRect(renderer, rect);
+}
+
+void SDLRenderer::getClipRect(SDL_Rect &rect) const
+{
+    SDL_RenderGetClipRect(renderer, &rect);
+}
+
+void SDLRenderer::setDrawColour(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    SDL_SetRenderDrawColor(renderer, r, g, b, a);
+}
+
+void SDLRenderer::clear()
+{
+    SDL_RenderClear(renderer);
+}
+
+void SDLRenderer::drawPoint(int x, int y)
+{
+    SDL_RenderDrawPoint(renderer, x, y);
+}
+
+void SDLRenderer::drawRect(const SDL_Rect &rect)
+{
+    SDL_RenderDrawRect(renderer, &rect);
+}
+
+void SDLRenderer::fillRect(const SDL_Rect &rect)
+{
+    SDL_RenderFillRect(renderer, &rect);
+}
+
+void SDLRenderer::copy(const Texture &texture, const SDL_Rect *srcRect, const SDL_Rect *dstRect, bool flipX)
+{
+    auto sdlTexture = getSDLTexture(texture);
+
+    if(!sdlTexture)
+        return;
+
+    if(texture.alpha != 255)
+        SDL_SetTextureAlphaMod(sdlTexture, texture.alpha);
+
+    if(flipX)
+        SDL_RenderCopyEx(renderer, sdlTexture, srcRect, dstRect, 0.0, nullptr, SDL_FLIP_HORIZONTAL);
+    else
+        SDL_RenderCopy(renderer, sdlTexture, srcRect, dstRect);
+}
+
+// uploads textures created by createTexture
+SDL_Texture *SDLRenderer::getSDLTexture(const Texture &texture)
+{
+    if(!texture.sdlTexture && texture.surface)
+    {
+        auto sdlTexture = SDL_CreateTextureFromSurface(renderer, texture.surface.get());
+
+        if(sdlTexture)
+            texture.sdlTexture = std::shared_ptr<SDL_Texture>(sdlTexture, SDL_DestroyTexture);
+        else
+            std::cerr << "Failed to create texture (" << SDL_GetError() << ")\n";
+
+        // don't try again
+        texture.surface.reset();
+    }
+
+    return texture.sdlTexture.get();
+}
+
+void SDLRenderer::present()
+{
+    SDL_RenderPresent(renderer);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "Renderer.hpp"
+
+// renders using SDL_Renderer
+class SDLRenderer final : public Renderer
+{
+public:
+    SDLRenderer(SDL_Renderer *renderer);
+
+    std::shared_ptr<Texture> createTexture(SDL_Surface *surface) override;
+    void uploadTexture(const Texture &texture) override;
+
+    bool getTargetsSupported() const override;
+    std::shared_ptr<Texture> createTarget(int width, int height) override;
+    void setTarget(std::shared_ptr<Texture> target) override;
+    std::shared_ptr<Texture> getTarget() const override;
+
+    void setClipRect(const SDL_Rect *rect) override;
+    void getClipRect(SDL_Rect &rect) const override;
+
+    void setDrawColour(uint8_t r, uint8_t g, uint8_t b, uint8_t a) override;
+
+    void clear() override;
+    void drawPoint(int x, int y) override;
+    void drawRect(const SDL_Rect &rect) override;
+    void fillRect(const SDL_Rect &rect) override;
+
+    void copy(const Texture &texture, const SDL_Rect *srcRect, const SDL_Rect *dstRect, bool flipX = false) override;
+
+    void present() override;
+
+private:
+    SDL_Texture *getSDLTexture(const Texture &texture);
+
+    SDL_Renderer *renderer;
+
+    std::shared_ptr<Texture> target;
+};
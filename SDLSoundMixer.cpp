@@ -1,10 +1,15 @@
-#include "SoundMixer.hpp"
+#include "SDLSoundMixer.hpp"
 
-SoundMixer::SoundMixer(FileLoader &fileLoader) : loader(fileLoader)
+SDLSoundMixer::SDLSoundMixer(FileLoader &fileLoader) : loader(fileLoader)
 {
 }
 
-uint32_t SoundMixer::playSound(const std::shared_ptr<Mix_Chunk> &sound, int priority)
+std::shared_ptr<Mix_Chunk> SDLSoundMixer::loadSound(int32_t id)
+{
+    return loader.loadSound(id);
+}
+
+uint32_t SDLSoundMixer::playSound(const std::shared_ptr<Mix_Chunk> &sound, int priority)
 {
     // TODO: priority
     int chan = Mix_PlayChannel(-1, sound.get(), 0);
@@ -22,7 +27,7 @@ uint32_t SoundMixer::playSound(const std::shared_ptr<Mix_Chunk> &sound, int prio
     return ~0u;
 }
 
-bool SoundMixer::isSoundPlaying(uint32_t id) const
+bool SDLSoundMixer::isSoundPlaying(uint32_t id) const
 {
     for(auto &soundChan : playingSounds)
     {
@@ -31,8 +36,3 @@ bool SoundMixer::isSoundPlaying(uint32_t id) const
     }
     return false;
 }
-
-SoundLoader &SoundMixer::getLoader()
-{
-    return loader;
-}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <map>
+
+#include "SoundLoader.hpp"
+#include "SoundMixer.hpp"
+
+// plays sounds using SDL_mixer
+class SDLSoundMixer final : public SoundMixer
+{
+public:
+    SDLSoundMixer(FileLoader &fileLoader);
+
+    std::shared_ptr<Mix_Chunk> loadSound(int32_t id) override;
+
+    uint32_t playSound(const std::shared_ptr<Mix_Chunk> &sound, int priority) override;
+
+    bool isSoundPlaying(uint32_t id) const override;
+
+private:
+    SoundLoader loader;
+
+    struct SoundInfo
+    {
+        std::shared_ptr<Mix_Chunk> chunk;
+        uint32_t id;
+    };
+
+    uint32_t nextSoundId = 0;
+
+    std::map<int, SoundInfo> playingSounds;
+};
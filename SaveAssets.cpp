@@ -0,0 +1,168 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "SaveAssets.hpp"
+
+#include "MappedFile.hpp"
+#include "NativeSave.hpp"
+#include "World.hpp"
+
+bool SaveAssets::read(const std::filesystem::path &path)
+{
+    backdropPath.clear();
+    objectIds.clear();
+
+    std::ifstream file(path, std::ios::binary);
+
+    if(!file)
+    {
+        std::cerr << "Failed to open " << path << "\n";
+        return false;
+    }
+
+    uint8_t header[0x114];
+
+    if(file.read(reinterpret_cast<char *>(header), sizeof(header)).gcount() < 4)
+    {
+        std::cerr << "Failed to read header for " << path << "\n";
+        return false;
+    }
+
+    if(memcmp(header, NativeSave::magic, sizeof(NativeSave::magic)) == 0)
+    {
+        file.close();
+        return readNative(path);
+    }
+
+    if(file.gcount() != sizeof(header))
+    {
+        std::cerr << "Failed to read header for " << path << "\n";
+        return false;
+    }
+
+    uint16_t width = header[2] | header[3] << 8;
+    uint16_t height = header[4] | header[5] << 8;
+
+    uint32_t numObjects = header[8] | header[9] << 8 | header[10] << 16 | header[11] << 24;
+    uint16_t numTrains = header[12] | header[13] << 8;
+
+    header[sizeof(header) - 1] = 0;
+    backdropPath = World::getBackdropPath(reinterpret_cast<char *>(header + 14));
+
+    // skip the tiles
+    file.seekg(std::streamoff(sizeof(header) + size_t(width) * height));
+
+    // only the ids, a batch of objects at a time
+    const uint32_t batchSize = 256;
+    std::vector<uint8_t> objectData(batchSize * 0x80);
+
+    for(uint32_t i = 0; i < numObjects; i += batchSize)
+    {
+        auto count = std::min(batchSize, numObjects - i);
+        auto bytes = std::streamsize(count * 0x80);
+
+        if(file.read(reinterpret_cast<char *>(objectData.data()), bytes).gcount() != bytes)
+        {
+            std::cerr << "Failed to read objects in " << path << "\n";
+            return false;
+        }
+
+        for(uint32_t j = 0; j < count; j++)
+            objectIds.push_back(objectData[j * 0x80] | objectData[j * 0x80 + 1] << 8);
+
+        // most objects share an id with many others
+        std::sort(objectIds.begin(), objectIds.end());
+        objectIds.erase(std::unique(objectIds.begin(), objectIds.end()), objectIds.end());
+    }
+
+    for(int i = 0; i < numTrains; i++)
+    {
+        uint8_t trainData[44];
+
+        if(file.read(reinterpret_cast<char *>(trainData), sizeof(trainData)).gcount() != sizeof(trainData))
+        {
+            std::cerr << "Failed to read trains in " << path << "\n";
+            return false;
+        }
+
+        uint32_t ids[4];
+        memcpy(ids, trainData, sizeof(ids));
+
+        for(auto id : ids)
+        {
+            if(id)
+                objectIds.push_back(uint16_t(id));
+        }
+    }
+
+    std::sort(objectIds.begin(), objectIds.end());
+    objectIds.erase(std::unique(objectIds.begin(), objectIds.end()), objectIds.end());
+
+    return true;
+}
+
+// only checks the sections that are used
+bool SaveAssets::readNative(const std::filesystem::path &path)
+{
+    MappedFile mappedFile;
+
+    if(!mappedFile.open(path))
+    {
+        std::cerr << "Failed to map " << path << "\n";
+        return false;
+    }
+
+    auto data = mappedFile.getData();
+    auto size = mappedFile.getSize();
+
+    NativeSave::Header header;
+
+    if(size < sizeof(header))
+    {
+        std::cerr << "Failed to read header for " << path << "\n";
+        return false;
+    }
+
+    memcpy(&header, data, sizeof(header));
+
+    auto checkSection = [size](const NativeSave::Section &section, uint64_t expectedSize)
+    {
+        return section.offset <= size && section.size <= size - section.offset && section.size == expectedSize;
+    };
+
+    bool valid = header.version == NativeSave::version
+              && checkSection(header.ids, header.numObjects * sizeof(uint16_t))
+              && checkSection(header.trains, header.numTrains * sizeof(NativeSave::Train))
+              && checkSection(header.strings, header.strings.size)
+              && header.backdropName < header.strings.size && header.strings.size && data[header.strings.offset + header.strings.size - 1] == 0;
+
+    if(!valid)
+    {
+        std::cerr << "Corrupt save " << path << "\n";
+        return false;
+    }
+
+    backdropPath = World::getBackdropPath(reinterpret_cast<const char *>(data + header.strings.offset + header.backdropName));
+
+    objectIds.resize(header.numObjects);
+    memcpy(objectIds.data(), data + header.ids.offset, header.ids.size);
+
+    for(uint32_t i = 0; i < header.numTrains; i++)
+    {
+        NativeSave::Train train;
+        memcpy(&train, data + header.trains.offset + i * sizeof(train), sizeof(train));
+
+        for(auto id : train.ids)
+        {
+            if(id)
+                objectIds.push_back(uint16_t(id));
+        }
+    }
+
+    std::sort(objectIds.begin(), objectIds.end());
+    objectIds.erase(std::unique(objectIds.begin(), objectIds.end()), objectIds.end());
+
+    return true;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// what loading a save will need, read without loading it (to load things ahead of time)
+class SaveAssets final
+{
+public:
+    // .SAV or native
+    bool read(const std::filesystem::path &path);
+
+    std::string backdropPath;
+    std::vector<uint16_t> objectIds; // sorted, no duplicates, includes train parts
+
+private:
+    bool readNative(const std::filesystem::path &path);
+};
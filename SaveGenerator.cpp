@@ -0,0 +1,441 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "NativeSave.hpp"
+
+// writes large synthetic .SAV files for scaling tests
+// (or converts an existing one to the native format)
+// everything is placed on a grid of 2x2 tile cells, which is the size of the track pieces
+
+// ids from the bundled saves
+enum TrackPiece : uint16_t
+{
+    TopRight = 13312,
+    BottomRight = 13313,
+    TopLeft = 13314,
+    BottomLeft = 13315,
+    Horizontal = 13320,
+    Vertical = 13321,
+};
+
+static const std::vector<uint16_t> defaultScenery{4118, 3100, 3098, 4098, 4136, 12288};
+
+// tile types, see World::loadSave
+static const uint8_t emptyTile = 0, sceneryTile = 2, trackTile = 5;
+
+static const int cellSize = 2;
+
+struct Options
+{
+    unsigned int width = 256, height = 256;
+    float density = 0.3f;
+    unsigned int loops = 4;
+    unsigned int trains = 0;
+    unsigned int carriages = 3;
+    uint16_t engineId = 0, carriageId = 0, depotId = 0;
+    std::vector<uint16_t> sceneryIds = defaultScenery;
+    uint64_t seed = 0;
+    std::string backdrop;
+    std::string outPath;
+
+    std::string convertPath;
+    bool delta = false;
+};
+
+struct Loop
+{
+    unsigned int x0, y0, x1, y1; // corner cells
+};
+
+static uint64_t splitMix64(uint64_t x)
+{
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// decided per cell so that the tile and object passes agree without storing anything
+static int getScenery(const Options &options, uint64_t cellIndex)
+{
+    auto hash = splitMix64(options.seed ^ splitMix64(cellIndex));
+
+    if((hash >> 40) * (1.0f / (1 << 24)) >= options.density)
+        return -1;
+
+    return options.sceneryIds[(hash & 0xFFFFFF) % options.sceneryIds.size()];
+}
+
+static void writeObject(std::ostream &stream, uint16_t id, unsigned int x, unsigned int y)
+{
+    uint8_t data[0x80]{};
+
+    data[0] = id;
+    data[1] = id >> 8;
+    data[2] = x;
+    data[3] = x >> 8;
+    data[4] = y;
+    data[5] = y >> 8;
+    // frameset 0, no name/minifigs
+
+    stream.write(reinterpret_cast<char *>(data), sizeof(data));
+}
+
+static void usage(const char *name)
+{
+    std::cerr << "usage: " << name << " [options] out.sav\n"
+              << "       " << name << " --convert in.sav [--delta] out\n"
+              << "  --size WxH         world size in tiles, up to 65535 (256x256)\n"
+              << "  --density D        fraction of free cells with scenery (0.3)\n"
+              << "  --scenery ID,...   scenery object ids\n"
+              << "  --loops N          number of track loops (4)\n"
+              << "  --trains N         number of trains, needs ids for the engine and depot (0)\n"
+              << "  --engine ID\n"
+              << "  --carriage ID\n"
+              << "  --carriages N      carriages per train (3)\n"
+              << "  --depot ID         replaces a piece of track in the loops with trains\n"
+              << "  --backdrop NAME\n"
+              << "  --seed N\n"
+              << "  --convert PATH     write PATH in the native format instead of generating\n"
+              << "  --delta            delta code coordinates when converting\n";
+}
+
+static bool parseArgs(int argc, char *argv[], Options &options)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        std::string_view arg(argv[i]);
+
+        // everything else takes a value
+        if(arg.substr(0, 2) != "--")
+        {
+            options.outPath = argv[i];
+            continue;
+        }
+
+        if(arg == "--delta")
+        {
+            options.delta = true;
+            continue;
+        }
+
+        if(i + 1 >= argc)
+            return false;
+
+        const char *value = argv[++i];
+
+        if(arg == "--size")
+        {
+            char *end;
+            options.width = strtoul(value, &end, 10);
+
+            if(*end != 'x')
+                return false;
+
+            options.height = strtoul(end + 1, nullptr, 10);
+        }
+        else if(arg == "--density")
+            options.density = atof(value);
+        else if(arg == "--scenery")
+        {
+            options.sceneryIds.clear();
+
+            for(char *ptr = const_cast<char *>(value); *ptr;)
+            {
+                options.sceneryIds.push_back(strtoul(ptr, &ptr, 10));
+
+                if(*ptr == ',')
+                    ptr++;
+            }
+        }
+        else if(arg == "--loops")
+            options.loops = atoi(value);
+        else if(arg == "--trains")
+            options.trains = atoi(value);
+        else if(arg == "--engine")
+            options.engineId = atoi(value);
+        else if(arg == "--carriage")
+            options.carriageId = atoi(value);
+        else if(arg == "--carriages")
+            options.carriages = std::clamp(atoi(value), 0, 3);
+        else if(arg == "--depot")
+            options.depotId = atoi(value);
+        else if(arg == "--backdrop")
+            options.backdrop = value;
+        else if(arg == "--seed")
+            options.seed = strtoull(value, nullptr, 10);
+        else if(arg == "--convert")
+            options.convertPath = value;
+        else
+            return false;
+    }
+
+    if(options.outPath.empty() || options.width < cellSize || options.height < cellSize || options.width > 0xFFFF || options.height > 0xFFFF)
+        return false;
+
+    if(options.trains > 0xFFFF)
+        return false;
+
+    if(options.sceneryIds.empty())
+        options.density = 0.0f;
+
+    if(options.trains && (!options.engineId || !options.depotId))
+    {
+        std::cerr << "trains need --engine and --depot\n";
+        return false;
+    }
+
+    return true;
+}
+
+// random non-overlapping rectangles of track, with a cell gap between them
+static std::vector<Loop> placeLoops(const Options &options, unsigned int cellsX, unsigned int cellsY, std::vector<bool> &trackCells)
+{
+    std::mt19937_64 randomGen(options.seed);
+
+    std::vector<Loop> loops;
+
+    const unsigned int minSize = 4, maxSize = 64;
+
+    if(cellsX < minSize + 2 || cellsY < minSize + 2)
+        return loops;
+
+    for(unsigned int attempt = 0; loops.size() < options.loops && attempt < options.loops * 100; attempt++)
+    {
+        unsigned int w = std::uniform_int_distribution<unsigned int>(minSize, std::min(maxSize, cellsX - 2))(randomGen);
+        unsigned int h = std::uniform_int_distribution<unsigned int>(minSize, std::min(maxSize, cellsY - 2))(randomGen);
+
+        Loop loop;
+        loop.x0 = std::uniform_int_distribution<unsigned int>(1, cellsX - w - 1)(randomGen);
+        loop.y0 = std::uniform_int_distribution<unsigned int>(1, cellsY - h - 1)(randomGen);
+        loop.x1 = loop.x0 + w - 1;
+        loop.y1 = loop.y0 + h - 1;
+
+        // check the area around it is clear
+        bool clear = true;
+
+        for(auto &other : loops)
+        {
+            if(loop.x0 <= other.x1 + 1 && loop.x1 + 1 >= other.x0 && loop.y0 <= other.y1 + 1 && loop.y1 + 1 >= other.y0)
+            {
+                clear = false;
+                break;
+            }
+        }
+
+        if(!clear)
+            continue;
+
+        for(unsigned int x = loop.x0; x <= loop.x1; x++)
+        {
+            trackCells[x + loop.y0 * size_t(cellsX)] = true;
+            trackCells[x + loop.y1 * size_t(cellsX)] = true;
+        }
+
+        for(unsigned int y = loop.y0; y <= loop.y1; y++)
+        {
+            trackCells[loop.x0 + y * size_t(cellsX)] = true;
+            trackCells[loop.x1 + y * size_t(cellsX)] = true;
+        }
+
+        loops.push_back(loop);
+    }
+
+    if(loops.size() < options.loops)
+        std::cerr << "Only placed " << loops.size() << " of " << options.loops << " loops\n";
+
+    return loops;
+}
+
+static void writeLoop(std::ostream &stream, const Loop &loop, bool hasDepot, uint16_t depotId)
+{
+    auto write = [&stream](uint16_t id, unsigned int cellX, unsigned int cellY)
+    {
+        writeObject(stream, id, cellX * cellSize, cellY * cellSize);
+    };
+
+    write(TopLeft, loop.x0, loop.y0);
+    write(TopRight, loop.x1, loop.y0);
+    write(BottomLeft, loop.x0, loop.y1);
+    write(BottomRight, loop.x1, loop.y1);
+
+    for(unsigned int x = loop.x0 + 1; x < loop.x1; x++)
+    {
+        // depot replaces the first piece of the top
+        write(hasDepot && x == loop.x0 + 1 ? depotId : uint16_t(Horizontal), x, loop.y0);
+        write(Horizontal, x, loop.y1);
+    }
+
+    for(unsigned int y = loop.y0 + 1; y < loop.y1; y++)
+    {
+        write(Vertical, loop.x0, y);
+        write(Vertical, loop.x1, y);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+
+    if(!parseArgs(argc, argv, options))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if(!options.convertPath.empty())
+        return NativeSave::convert(options.convertPath, options.outPath, options.delta) ? 0 : 1;
+
+    unsigned int cellsX = options.width / cellSize;
+    unsigned int cellsY = options.height / cellSize;
+
+    std::vector<bool> trackCells(size_t(cellsX) * cellsY);
+
+    auto loops = placeLoops(options, cellsX, cellsY, trackCells);
+
+    // one depot for each loop with a train
+    unsigned int numDepots = std::min<size_t>(options.trains, loops.size());
+
+    if(options.trains && !numDepots)
+    {
+        std::cerr << "No loops to put trains on\n";
+        return 1;
+    }
+
+    // count objects first, so that nothing is written if there are too many
+    uint64_t numObjects = 0;
+
+    for(auto &loop : loops)
+        numObjects += (loop.x1 - loop.x0 + loop.y1 - loop.y0) * 2;
+
+    for(size_t cellIndex = 0; cellIndex < trackCells.size(); cellIndex++)
+    {
+        if(!trackCells[cellIndex] && getScenery(options, cellIndex) != -1)
+            numObjects++;
+    }
+
+    if(numObjects > 0xFFFFFFFF)
+    {
+        std::cerr << "Too many objects (" << numObjects << "), reduce the size or density\n";
+        return 1;
+    }
+
+    std::ofstream file(options.outPath, std::ios::binary);
+
+    if(!file)
+    {
+        std::cerr << "Failed to open " << options.outPath << "\n";
+        return 1;
+    }
+
+    // bigger buffer, we're writing a lot of small records
+    std::vector<char> buffer(1 << 20);
+    file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+
+    uint8_t header[0x114]{};
+    header[0] = 8;
+    header[2] = options.width;
+    header[3] = options.width >> 8;
+    header[4] = options.height;
+    header[5] = options.height >> 8;
+    header[8] = numObjects;
+    header[9] = numObjects >> 8;
+    header[10] = numObjects >> 16;
+    header[11] = numObjects >> 24;
+    header[12] = options.trains;
+    header[13] = options.trains >> 8;
+
+    // name without path/extension, empty for the default
+    strncpy(reinterpret_cast<char *>(header + 14), options.backdrop.c_str(), sizeof(header) - 15);
+
+    file.write(reinterpret_cast<char *>(header), sizeof(header));
+
+    // tile types
+    std::vector<uint8_t> row(options.width);
+
+    for(unsigned int y = 0; y < options.height; y++)
+    {
+        unsigned int cellY = y / cellSize;
+
+        for(unsigned int x = 0; x < options.width; x++)
+        {
+            unsigned int cellX = x / cellSize;
+
+            // partial cells at the edges are left empty
+            if(cellX >= cellsX || cellY >= cellsY)
+                row[x] = emptyTile;
+            else
+            {
+                size_t cellIndex = cellX + cellY * size_t(cellsX);
+
+                if(trackCells[cellIndex])
+                    row[x] = trackTile;
+                else
+                    row[x] = getScenery(options, cellIndex) != -1 ? sceneryTile : emptyTile;
+            }
+        }
+
+        file.write(reinterpret_cast<char *>(row.data()), row.size());
+    }
+
+    // objects, track first
+    for(size_t i = 0; i < loops.size(); i++)
+        writeLoop(file, loops[i], i < numDepots, options.depotId);
+
+    for(unsigned int cellY = 0; cellY < cellsY; cellY++)
+    {
+        for(unsigned int cellX = 0; cellX < cellsX; cellX++)
+        {
+            size_t cellIndex = cellX + cellY * size_t(cellsX);
+
+            if(trackCells[cellIndex])
+                continue;
+
+            int id = getScenery(options, cellIndex);
+
+            if(id != -1)
+                writeObject(file, id, cellX * cellSize, cellY * cellSize);
+        }
+    }
+
+    // trains
+    for(unsigned int i = 0; i < options.trains; i++)
+    {
+        uint8_t trainData[44]{};
+
+        uint32_t ids[4]{options.engineId};
+        uint32_t types[4]{1}; // not steam
+
+        for(unsigned int j = 1; j <= options.carriages && options.carriageId; j++)
+        {
+            ids[j] = options.carriageId;
+            types[j] = 2; // passenger
+        }
+
+        memcpy(trainData, ids, sizeof(ids));
+        memcpy(trainData + 16, types, sizeof(types));
+        auto name = "Train " + std::to_string(i + 1);
+        strncpy(reinterpret_cast<char *>(trainData + 32), name.c_str(), sizeof(trainData) - 33);
+
+        file.write(reinterpret_cast<char *>(trainData), sizeof(trainData));
+    }
+
+    if(!file.flush())
+    {
+        std::cerr << "Failed to write " << options.outPath << "\n";
+        return 1;
+    }
+
+    std::cout << "Wrote " << options.outPath << ": " << options.width << "x" << options.height << ", "
+              << numObjects << " objects, " << loops.size() << " loops, " << options.trains << " trains\n";
+
+    return 0;
+}
@@ -0,0 +1,544 @@
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "SaveLoader.hpp"
+
+#include "ObjectData.hpp"
+#include "SaveAssets.hpp"
+
+SaveLoader::SaveLoader(World &world, std::filesystem::path path) : world(world), path(std::move(path))
+{
+}
+
+bool SaveLoader::update(uint32_t budgetMs, uint32_t maxRecords)
+{
+    using Clock = std::chrono::steady_clock;
+
+    auto endTime = Clock::now() + std::chrono::milliseconds(budgetMs);
+    uint32_t records = 0;
+
+    while(phase != Phase::Done && phase != Phase::Failed)
+    {
+        bool ok = true;
+
+        switch(phase)
+        {
+            case Phase::Header:
+                ok = loadHeader();
+                phase = Phase::Prefetch;
+                break;
+
+            case Phase::Prefetch:
+                if(!prefetch())
+                    phase = Phase::Tiles;
+                break;
+
+            case Phase::Tiles:
+                ok = loadTiles();
+                phase = Phase::Objects;
+                index = 0;
+                break;
+
+            case Phase::Objects:
+                if(index < numObjects)
+                {
+                    ok = native ? loadNativeObject() : loadObject();
+                    index++;
+                }
+                else
+                {
+                    phase = Phase::Trains;
+                    index = 0;
+                }
+                break;
+
+            case Phase::Trains:
+                if(index < numTrains)
+                {
+                    ok = native ? loadNativeTrain() : loadTrain();
+                    index++;
+                }
+                else
+                    phase = Phase::EasterEggs;
+                break;
+
+            case Phase::EasterEggs:
+                world.finishLoad();
+
+                // time events create objects later, keep them loaded
+                for(auto &event : world.timeEvents)
+                {
+                    auto it = resources.find(event.resId);
+
+                    if(it != resources.end() && std::get<0>(it->second))
+                        world.eventTextures.push_back(std::get<0>(it->second));
+                }
+
+                // done with the file
+                file.close();
+                mappedFile.close();
+                resources.clear();
+
+                phase = Phase::Done;
+                break;
+
+            case Phase::Done:
+            case Phase::Failed:
+                break;
+        }
+
+        if(!ok)
+        {
+            phase = Phase::Failed;
+            break;
+        }
+
+        recordsDone++;
+        records++;
+
+        if((maxRecords && records >= maxRecords) || (budgetMs && Clock::now() >= endTime))
+            break;
+    }
+
+    return phase != Phase::Done && phase != Phase::Failed;
+}
+
+SaveLoader::Phase SaveLoader::getPhase() const
+{
+    return phase;
+}
+
+float SaveLoader::getProgress() const
+{
+    if(phase == Phase::Done)
+        return 1.0f;
+
+    // a step per record/prefetched id, plus header, tiles, easter eggs and the ends of the objects/trains
+    float total = 5.0f + numObjects + numTrains + prefetchIds.size();
+
+    return std::min(1.0f, (recordsDone + prefetchIndex) / total);
+}
+
+bool SaveLoader::loadHeader()
+{
+    file.open(path, std::ios::binary);
+
+    if(!file)
+    {
+        std::cerr << "Failed to open " << path;
+        return false;
+    }
+
+    // initial header
+    uint8_t header[0x114];
+
+    if(file.read(reinterpret_cast<char *>(header), sizeof(header)).gcount() < 4)
+    {
+        std::cerr << "Failed to read header for " << path << "\n";
+        return false;
+    }
+
+    // native saves are loaded from a mapping instead
+    if(memcmp(header, NativeSave::magic, sizeof(NativeSave::magic)) == 0)
+    {
+        file.close();
+        native = true;
+        return loadNativeHeader();
+    }
+
+    if(file.gcount() != sizeof(header))
+    {
+        std::cerr << "Failed to read header for " << path << "\n";
+        return false;
+    }
+
+    // always the same in every file so far
+    assert(header[0] == 8 && header[1] == 0);
+    assert(header[6] == 0 && header[7] == 0);
+
+    uint16_t width = header[2] | header[3] << 8;
+    uint16_t height = header[4] | header[5] << 8;
+
+    numObjects = header[8] | header[9] << 8 | header[10] << 16 | header[11] << 24;
+    numTrains = header[12] | header[13] << 8;
+
+    char *backdropName = reinterpret_cast<char *>(header + 14);
+
+    // the rest is usually 0
+#ifndef NDEBUG
+    auto ptr = header + 14 + strlen(backdropName);
+    for(; ptr < header + sizeof(ptr); ptr++)
+        assert(*ptr == 0);
+#endif
+
+    world.beginLoad(path, width, height, backdropName);
+
+    return true;
+}
+
+// validates everything, the columns are used directly from the mapping
+bool SaveLoader::loadNativeHeader()
+{
+    if(!mappedFile.open(path))
+    {
+        std::cerr << "Failed to map " << path << "\n";
+        return false;
+    }
+
+    auto data = mappedFile.getData();
+    auto size = mappedFile.getSize();
+
+    auto &header = nativeHeader;
+
+    if(size < sizeof(header))
+    {
+        std::cerr << "Failed to read header for " << path << "\n";
+        return false;
+    }
+
+    memcpy(&header, data, sizeof(header));
+
+    if(header.version != NativeSave::version)
+    {
+        std::cerr << "Unsupported version " << header.version << " of " << path << "\n";
+        return false;
+    }
+
+    bool deltaCoords = header.flags & NativeSave::DeltaCoords;
+    size_t numTiles = size_t(header.width) * header.height;
+
+    auto checkSection = [size](const NativeSave::Section &section, uint64_t expectedSize)
+    {
+        return section.offset % 8 == 0 && section.offset <= size && section.size <= size - section.offset && section.size == expectedSize;
+    };
+
+    bool valid = checkSection(header.tileTypes, numTiles)
+              && checkSection(header.ids, header.numObjects * sizeof(uint16_t))
+              && checkSection(header.xs, deltaCoords ? header.xs.size : header.numObjects * sizeof(uint16_t))
+              && checkSection(header.ys, deltaCoords ? header.ys.size : header.numObjects * sizeof(uint16_t))
+              && checkSection(header.framesets, header.numObjects * sizeof(int32_t))
+              && checkSection(header.names, header.numObjects * sizeof(uint32_t))
+              && checkSection(header.minifigs, header.numMinifigs * sizeof(NativeSave::Minifig))
+              && checkSection(header.trains, header.numTrains * sizeof(NativeSave::Train))
+              && checkSection(header.strings, header.strings.size)
+              && header.strings.size && data[header.strings.offset + header.strings.size - 1] == 0;
+
+    // objects take their minifigs in order while loading
+    if(valid)
+    {
+        auto minifigData = reinterpret_cast<const NativeSave::Minifig *>(data + header.minifigs.offset);
+        uint32_t lastObject = 0;
+
+        for(uint32_t i = 0; i < header.numMinifigs && valid; i++)
+        {
+            valid = minifigData[i].object >= lastObject && minifigData[i].object < header.numObjects;
+            lastObject = minifigData[i].object;
+        }
+    }
+
+    if(!valid)
+    {
+        std::cerr << "Corrupt save " << path << "\n";
+        return false;
+    }
+
+    numObjects = header.numObjects;
+    numTrains = header.numTrains;
+
+    strings = reinterpret_cast<const char *>(data + header.strings.offset);
+
+    ids = reinterpret_cast<const uint16_t *>(data + header.ids.offset);
+    framesets = reinterpret_cast<const int32_t *>(data + header.framesets.offset);
+    names = reinterpret_cast<const uint32_t *>(data + header.names.offset);
+    minifigs = reinterpret_cast<const NativeSave::Minifig *>(data + header.minifigs.offset);
+    minifigsEnd = minifigs + header.numMinifigs;
+    trains = reinterpret_cast<const NativeSave::Train *>(data + header.trains.offset);
+
+    if(deltaCoords)
+    {
+        if(!NativeSave::decodeCoords(data + header.xs.offset, header.xs.size, numObjects, decodedXs)
+        || !NativeSave::decodeCoords(data + header.ys.offset, header.ys.size, numObjects, decodedYs))
+        {
+            std::cerr << "Corrupt coordinates in " << path << "\n";
+            return false;
+        }
+
+        xs = decodedXs.data();
+        ys = decodedYs.data();
+    }
+    else
+    {
+        xs = reinterpret_cast<const uint16_t *>(data + header.xs.offset);
+        ys = reinterpret_cast<const uint16_t *>(data + header.ys.offset);
+    }
+
+    world.beginLoad(path, header.width, header.height, getNativeString(header.backdropName));
+
+    // chunks were all invalidated by beginLoad, so objects skip addObject
+    world.objects.reserve(numObjects);
+    world.objectStates.reserve(numObjects);
+
+    return true;
+}
+
+// a batch of ids at a time, so that the caller can still draw
+// failures aren't fatal, creating the objects will report them
+bool SaveLoader::prefetch()
+{
+    if(!prefetchStarted)
+    {
+        prefetchStarted = true;
+
+        // scans the records separately, objects are created in order later
+        SaveAssets assets;
+
+        if(assets.read(path))
+        {
+            for(auto id : assets.objectIds)
+                addPrefetchId(id);
+        }
+
+        // load events may replace objects (or the backdrop) depending on the date
+        auto lowerBackdropPath = world.backdropPath;
+        for(auto &c : lowerBackdropPath)
+            c = std::tolower(c);
+
+        for(auto &event : world.loadEvents)
+        {
+            if(prefetchSeen.count(event.oldId) || world.fileLoader.lookupId(event.oldId, ".bmp") == lowerBackdropPath)
+                addPrefetchId(event.newId);
+        }
+
+        // time events create objects later
+        for(auto &event : world.timeEvents)
+            addPrefetchId(event.resId);
+
+        return true;
+    }
+
+    if(prefetchIndex == prefetchIds.size())
+    {
+        // anything the easter eggs of loaded objects can change to or create
+        // (repeats until nothing new is found)
+        for(; prefetchExpanded < prefetchIds.size(); prefetchExpanded++)
+        {
+            auto data = std::get<1>(resources[prefetchIds[prefetchExpanded]]);
+
+            if(!data)
+                continue;
+
+            for(auto &easterEgg : data->easterEggs)
+            {
+                addPrefetchId(easterEgg.changeId);
+                addPrefetchId(easterEgg.newId);
+            }
+        }
+
+        if(prefetchIndex == prefetchIds.size())
+            return false;
+    }
+
+    // enough for every thread to have a few
+    auto &pool = world.updatePool;
+    auto count = std::min(prefetchIds.size() - prefetchIndex, size_t(pool.getNumThreads()) * 4);
+
+    prefetched.resize(count);
+
+    pool.parallelFor(static_cast<unsigned int>(count), [this](unsigned int i)
+    {
+        prefetched[i] = world.getObjectResources(prefetchIds[prefetchIndex + i]);
+    });
+
+    for(size_t i = 0; i < count; i++)
+        resources.emplace(prefetchIds[prefetchIndex + i], std::move(prefetched[i]));
+
+    prefetchIndex += count;
+    prefetched.clear();
+
+    return true;
+}
+
+void SaveLoader::addPrefetchId(int id)
+{
+    if(id <= 0 || id > 0xFFFF)
+        return;
+
+    if(prefetchSeen.insert(uint16_t(id)).second)
+        prefetchIds.push_back(uint16_t(id));
+}
+
+bool SaveLoader::loadTiles()
+{
+    // type of object in each tile?
+    // might be the preview image?
+    // empty tile=0, scenery=2, (non-rail)building=3, track=5, road=6, footpath=7
+    // (can be larger than an int for big worlds)
+    size_t numTiles = size_t(world.width) * world.height;
+
+    if(native)
+    {
+        memcpy(world.tileObjectType, mappedFile.getData() + nativeHeader.tileTypes.offset, numTiles);
+        return true;
+    }
+
+    if(file.read(reinterpret_cast<char *>(world.tileObjectType), numTiles).gcount() != std::streamsize(numTiles))
+    {
+        std::cerr << "Failed to read tile type data for " << path << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+bool SaveLoader::loadObject()
+{
+    uint8_t objectData[0x80];
+
+    if(file.read(reinterpret_cast<char *>(objectData), sizeof(objectData)).gcount() != sizeof(objectData))
+    {
+        std::cerr << "Failed to read object " << index << " in " << path << "\n";
+        return false;
+    }
+
+    uint16_t objectId = objectData[0] | objectData[1] << 8;
+    uint16_t objectX = objectData[2] | objectData[3] << 8;
+    uint16_t objectY = objectData[4] | objectData[5] << 8;
+
+    // 6-7 are probably padding to align the oversized frameset index
+
+    int framesetIndex = objectData[8] | objectData[9] << 8 | objectData[10] << 16 | objectData[11] << 24; // this is waaay bigger than it needs to be
+
+    // 4 bytes unknown?
+
+    char *objectName = reinterpret_cast<char *>(objectData + 16);
+
+    auto handle = world.addObject(objectId, objectX, objectY, objectName);
+    auto &object = *world.objects.get(handle);
+
+    world.setObjectAnimation(handle, framesetIndex);
+
+    bool hasUnk = false;
+
+    for(int j = 6; j < 16; j++)
+    {
+        if((j < 8 || j >= 12) && objectData[j])
+        {
+            if(!hasUnk)
+                std::cout << "object " << objectId << " (\"" << objectName << "\") at " << objectX << ", " << objectY << std::hex;
+
+            std::cout << " unk" << j << "=" << int(objectData[j]);
+            hasUnk = true;
+        }
+    }
+
+    if(hasUnk)
+        std::cout << std::dec << std::endl;
+
+    // up to 5 minifigs
+    auto minifigData = objectData + 0x1C;
+    for(int j = 0; j < 5; j++, minifigData += 20)
+    {
+        uint32_t minifigId = minifigData[0] | minifigData[1] << 8 | minifigData[2] << 16 | minifigData[3] << 24;
+
+        // 4 bytes unknown (possibly uninitialised data?)
+        char *minifigName = reinterpret_cast<char *>(minifigData + 8);
+
+        object.addMinifig(Minifig{minifigId, minifigName});
+
+        if(minifigId)
+        {
+            std::cout << "\tminifig " << minifigId << " \"" << minifigName << "\" (unk " << std::hex
+                      << int(minifigData[4]) << ", " << int(minifigData[5]) << ", "
+                      << int(minifigData[6]) << ", " << int(minifigData[7]) << std::dec << ")\n";
+        }
+    }
+
+    // collect depots for placing trains
+    if(object.getData() && object.getData()->specialType == ObjectData::SpecialType::Depot)
+        depots.push_back(handle);
+
+    return true;
+}
+
+bool SaveLoader::loadNativeObject()
+{
+    auto id = ids[index];
+
+    auto it = resources.find(id);
+
+    if(it == resources.end())
+        it = resources.emplace(id, world.getObjectResources(id)).first;
+
+    auto &[texture, objectData] = it->second;
+
+    auto handle = world.objects.emplace(id, xs[index], ys[index], getNativeString(names[index]), texture, objectData, world.objectStates);
+    auto &object = *world.objects.get(handle);
+
+    object.setSerial(world.nextObjectSerial++);
+
+    // an out of range frameset keeps the default, which still needs to start
+    if(!world.setObjectAnimation(handle, framesets[index]))
+        world.scheduleAnimation(handle);
+
+    for(; minifigs != minifigsEnd && minifigs->object == index; ++minifigs)
+        object.addMinifig(Minifig{minifigs->id, getNativeString(minifigs->name)});
+
+    if(objectData && objectData->specialType == ObjectData::SpecialType::Depot)
+        depots.push_back(handle);
+
+    return true;
+}
+
+bool SaveLoader::loadTrain()
+{
+    uint8_t trainData[44];
+
+    if(file.read(reinterpret_cast<char *>(trainData), sizeof(trainData)).gcount() != sizeof(trainData))
+    {
+        std::cerr << "Failed to read train " << index << " in " << path << "\n";
+        return false;
+    }
+
+    // first we have the object ids for the engine and carriages
+    uint32_t ids[4];
+    memcpy(ids, trainData, sizeof(ids));
+    // then another value related to each
+    // for engine: 1 = not steam, 2 = steam ?
+    // for carriage: 2 = passenger, 3 = cargo, 4 = mail ?
+    auto type = reinterpret_cast<uint32_t *>(trainData + 16);
+    // then a name
+    auto name = reinterpret_cast<char *>(trainData + 32);
+
+    std::cout << "\ttrain " << name;
+
+    for(int j = 0; j < 4; j++)
+    {
+        if(ids[j])
+            std::cout << " " << ids[j] << "(" << type[j] << ")";
+    }
+
+    std::cout << std::endl;
+
+    // TODO: shuffle depots?
+    world.addTrain(ids, type, name, depots, depotIndex);
+
+    return true;
+}
+
+bool SaveLoader::loadNativeTrain()
+{
+    auto &train = trains[index];
+    world.addTrain(train.ids, train.types, getNativeString(train.name), depots, depotIndex);
+
+    return true;
+}
+
+// invalid offsets get an empty string
+const char *SaveLoader::getNativeString(uint32_t offset) const
+{
+    return offset < nativeHeader.strings.size ? strings + offset : strings;
+}
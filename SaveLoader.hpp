@@ -0,0 +1,100 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "NativeSave.hpp"
+#include "World.hpp"
+
+// loads a .SAV or native save into a world a bit at a time
+// so that the caller can keep drawing/handling events
+class SaveLoader final
+{
+public:
+    enum class Phase
+    {
+        Header,
+        Prefetch, // loads everything the save needs in parallel
+        Tiles,
+        Objects,
+        Trains,
+        EasterEggs,
+
+        Done,
+        Failed
+    };
+
+    SaveLoader(World &world, std::filesystem::path path);
+    SaveLoader(SaveLoader &) = delete;
+
+    // works until the time or record budget runs out (0 = no limit)
+    // always does at least one step, returns false when done or failed
+    bool update(uint32_t budgetMs, uint32_t maxRecords = 0);
+
+    Phase getPhase() const;
+
+    // 0-1, mostly counts objects
+    float getProgress() const;
+
+private:
+    bool loadHeader();
+
+    bool prefetch();
+    void addPrefetchId(int id);
+
+    bool loadNativeHeader();
+    bool loadTiles();
+
+    bool loadObject();
+    bool loadNativeObject();
+
+    bool loadTrain();
+    bool loadNativeTrain();
+
+    const char *getNativeString(uint32_t offset) const;
+
+    World &world;
+    std::filesystem::path path;
+
+    Phase phase = Phase::Header;
+
+    uint32_t numObjects = 0, numTrains = 0;
+    uint32_t index = 0; // within the current phase
+    uint32_t recordsDone = 0;
+
+    std::vector<World::ObjectHandle> depots;
+    size_t depotIndex = 0;
+
+    // .SAV
+    std::ifstream file;
+
+    // native
+    bool native = false;
+    MappedFile mappedFile;
+    NativeSave::Header nativeHeader;
+
+    const uint16_t *ids, *xs, *ys;
+    const int32_t *framesets;
+    const uint32_t *names;
+    const NativeSave::Minifig *minifigs, *minifigsEnd;
+    const NativeSave::Train *trains;
+    const char *strings;
+
+    std::vector<uint16_t> decodedXs, decodedYs;
+
+    // every id the save (and its easter eggs/events) might use
+    // loading objects only uses these, so the caches are always warm
+    std::vector<uint16_t> prefetchIds;
+    std::unordered_set<uint16_t> prefetchSeen;
+    size_t prefetchIndex = 0, prefetchExpanded = 0;
+    bool prefetchStarted = false;
+    std::vector<std::tuple<std::shared_ptr<Texture>, const ObjectData *>> prefetched;
+
+    // most objects share an id with many others
+    std::unordered_map<uint16_t, std::tuple<std::shared_ptr<Texture>, const ObjectData *>> resources;
+};
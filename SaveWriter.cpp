@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "SaveWriter.hpp"
+
+SaveWriter::~SaveWriter()
+{
+    wait();
+}
+
+SaveSnapshot &SaveWriter::getSnapshot()
+{
+    return snapshot;
+}
+
+void SaveWriter::start(std::filesystem::path path)
+{
+    wait();
+
+    busy = true;
+
+    thread = std::thread([this, path = std::move(path)]
+    {
+        succeeded = write(snapshot, path);
+        busy = false;
+    });
+}
+
+bool SaveWriter::isBusy() const
+{
+    return busy;
+}
+
+bool SaveWriter::wait()
+{
+    if(thread.joinable())
+        thread.join();
+
+    return succeeded;
+}
+
+// the reverse of SaveLoader
+bool SaveWriter::write(const SaveSnapshot &snapshot, const std::filesystem::path &path)
+{
+    auto writeU16 = [](uint8_t *ptr, uint16_t value)
+    {
+        ptr[0] = value;
+        ptr[1] = value >> 8;
+    };
+
+    auto writeU32 = [](uint8_t *ptr, uint32_t value)
+    {
+        ptr[0] = value;
+        ptr[1] = value >> 8;
+        ptr[2] = value >> 16;
+        ptr[3] = value >> 24;
+    };
+
+    // write somewhere else first so a failure doesn't leave half a save
+    auto tmpPath = path;
+    tmpPath += ".tmp";
+
+    std::ofstream file(tmpPath, std::ios::binary);
+
+    if(!file)
+    {
+        std::cerr << "Failed to open " << tmpPath << "\n";
+        return false;
+    }
+
+    // header
+    uint8_t header[0x114]{};
+    header[0] = 8;
+    writeU16(header + 2, snapshot.width);
+    writeU16(header + 4, snapshot.height);
+    writeU32(header + 8, snapshot.objects.size());
+    writeU16(header + 12, snapshot.trains.size());
+    memcpy(header + 14, snapshot.backdrop.data(), std::min(snapshot.backdrop.size(), sizeof(header) - 15));
+
+    file.write(reinterpret_cast<char *>(header), sizeof(header));
+
+    file.write(reinterpret_cast<const char *>(snapshot.tileTypes.data()), snapshot.tileTypes.size());
+
+    // objects, in batches to keep the writes reasonably large
+    const size_t batchSize = 256;
+    std::vector<uint8_t> buffer(batchSize * 0x80);
+
+    auto minifig = snapshot.minifigs.begin();
+
+    for(size_t i = 0; i < snapshot.objects.size(); i += batchSize)
+    {
+        size_t count = std::min(batchSize, snapshot.objects.size() - i);
+
+        std::fill(buffer.begin(), buffer.end(), 0);
+
+        for(size_t j = 0; j < count; j++)
+        {
+            auto &object = snapshot.objects[i + j];
+            auto objectData = buffer.data() + j * 0x80;
+
+            writeU16(objectData + 0, object.id);
+            writeU16(objectData + 2, object.x);
+            writeU16(objectData + 4, object.y);
+            writeU32(objectData + 8, object.frameset);
+            memcpy(objectData + 16, object.name, sizeof(object.name));
+
+            // up to 5 minifigs
+            auto minifigData = objectData + 0x1C;
+
+            for(int k = 0; k < object.numMinifigs; k++, ++minifig)
+            {
+                if(k < 5)
+                {
+                    writeU32(minifigData, minifig->id);
+                    memcpy(minifigData + 8, minifig->name, sizeof(minifig->name));
+                    minifigData += 20;
+                }
+            }
+        }
+
+        file.write(reinterpret_cast<char *>(buffer.data()), count * 0x80);
+    }
+
+    // trains
+    for(auto &train : snapshot.trains)
+    {
+        uint8_t trainData[44]{};
+
+        for(int i = 0; i < 4; i++)
+        {
+            writeU32(trainData + i * 4, train.ids[i]);
+            writeU32(trainData + 16 + i * 4, train.types[i]);
+        }
+
+        memcpy(trainData + 32, train.name, sizeof(train.name));
+
+        file.write(reinterpret_cast<char *>(trainData), sizeof(trainData));
+    }
+
+    file.close();
+
+    if(!file)
+    {
+        std::cerr << "Failed to write " << tmpPath << "\n";
+        std::error_code error;
+        std::filesystem::remove(tmpPath, error);
+        return false;
+    }
+
+    // replaces the old save in one go
+    std::error_code error;
+    std::filesystem::rename(tmpPath, path, error);
+
+    if(error)
+    {
+        std::cerr << "Failed to rename " << tmpPath << " to " << path << ": " << error.message() << "\n";
+        std::filesystem::remove(tmpPath, error);
+        return false;
+    }
+
+    return true;
+}
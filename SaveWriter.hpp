@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+// what goes in a .SAV, copied out of the world at the end of a tick
+// plain values so it's cheap to take and safe to use from another thread
+struct SaveSnapshot
+{
+    struct Object
+    {
+        uint16_t id, x, y;
+        int32_t frameset;
+        char name[12];
+        uint8_t numMinifigs;
+    };
+
+    struct Minifig
+    {
+        uint32_t id;
+        char name[12];
+    };
+
+    struct Train
+    {
+        uint32_t ids[4];
+        uint32_t types[4];
+        char name[12];
+    };
+
+    uint16_t width = 0, height = 0;
+    std::string backdrop;
+
+    std::vector<uint8_t> tileTypes;
+    std::vector<Object> objects;
+    std::vector<Minifig> minifigs; // in object order
+    std::vector<Train> trains;
+};
+
+// writes snapshots in the background, replacing the file when complete
+class SaveWriter final
+{
+public:
+    SaveWriter() = default;
+    SaveWriter(SaveWriter &) = delete;
+    ~SaveWriter();
+
+    // fill this in and then call start
+    // (not while busy, the writer thread is using it)
+    SaveSnapshot &getSnapshot();
+
+    // encodes and writes the snapshot on another thread
+    void start(std::filesystem::path path);
+
+    bool isBusy() const;
+
+    // waits for the current write, returns false if it (or the last one) failed
+    bool wait();
+
+    // encodes and writes in the calling thread, via a temporary file
+    static bool write(const SaveSnapshot &snapshot, const std::filesystem::path &path);
+
+private:
+    SaveSnapshot snapshot;
+
+    std::thread thread;
+    std::atomic<bool> busy{false};
+    bool succeeded = true;
+};
@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <iostream>
+
+#include "Simulation.hpp"
+
+#include "World.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// wake up occasionally even if nothing is scheduled
+static const uint32_t maxIdleDelay = 1000;
+
+// give up on catching up after falling this far behind (and drop the time)
+static const unsigned int maxCatchUpTicks = 2 * maxIdleDelay / Simulation::tickMs;
+
+Simulation::Simulation(World &world, SoundMixer &sound) : world(world), sound(sound)
+{
+    snapshotEvent = SDL_RegisterEvents(1);
+}
+
+Simulation::~Simulation()
+{
+    stop();
+}
+
+void Simulation::start()
+{
+    if(thread.joinable())
+        return;
+
+    stopping = false;
+
+    // the world may have been switched to another save while stopped
+    rewindBuffer.clear();
+
+    thread = std::thread(&Simulation::run, this);
+}
+
+void Simulation::stop()
+{
+    if(!thread.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        stopping = true;
+    }
+
+    inputCond.notify_one();
+    thread.join();
+
+    if(recording && !replaying)
+        recording->length = tickCount;
+
+    // final save, waits for it
+    if(autosaveTicks)
+    {
+        autosave();
+        saveWriter.wait();
+    }
+}
+
+void Simulation::queueEvent(const SDL_Event &event)
+{
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        input.push_back(event);
+    }
+
+    inputCond.notify_one();
+}
+
+bool Simulation::updateSnapshot()
+{
+    return snapshots.update();
+}
+
+const RenderSnapshot &Simulation::getSnapshot() const
+{
+    return snapshots.getFront();
+}
+
+float Simulation::getInterpolation() const
+{
+    auto &snapshot = getSnapshot();
+
+    if(!snapshot.moving || snapshot.tickLength == Clock::duration::zero())
+        return 1.0f;
+
+    auto elapsed = std::chrono::duration<float>(Clock::now() - snapshot.time);
+
+    return std::min(1.0f, std::max(0.0f, elapsed / snapshot.tickLength));
+}
+
+void Simulation::setTimeScale(unsigned int scale)
+{
+    timeScale = scale;
+}
+
+void Simulation::record(Recording &recording)
+{
+    this->recording = &recording;
+    replaying = false;
+}
+
+void Simulation::replay(Recording &recording)
+{
+    this->recording = &recording;
+    replaying = true;
+    replayPos = 0;
+}
+
+bool Simulation::getReplayFinished() const
+{
+    return replayFinished;
+}
+
+void Simulation::setAutosave(std::filesystem::path path, uint32_t intervalMs)
+{
+    autosavePath = std::move(path);
+    autosaveTicks = std::max(1u, intervalMs / tickMs);
+}
+
+void Simulation::setRewind(uint32_t intervalMs, uint32_t lengthMs)
+{
+    auto intervalTicks = std::max(1u, intervalMs / tickMs);
+    rewindInterval = intervalTicks;
+
+    // a keyframe about every 30s
+    rewindBuffer.setLimits(lengthMs / tickMs / intervalTicks + 1, std::max(1u, 30 * 1000 / tickMs / intervalTicks));
+}
+
+void Simulation::rewind(uint32_t ms)
+{
+    {
+        std::lock_guard<std::mutex> lock(inputMutex);
+        rewindRequest = std::max(1u, ms / tickMs);
+    }
+
+    inputCond.notify_one();
+}
+
+uint64_t Simulation::getTickCount() const
+{
+    return tickCount;
+}
+
+uint32_t Simulation::getSnapshotEvent() const
+{
+    return snapshotEvent;
+}
+
+void Simulation::run()
+{
+    const Clock::duration tickLength = std::chrono::milliseconds(tickMs);
+
+    std::vector<SDL_Event> pending;
+
+    // simulated time that hasn't been ticked yet
+    Clock::duration accumulator{0};
+    auto lastTime = Clock::now();
+
+    std::unique_lock<std::mutex> lock(inputMutex);
+
+    while(!stopping)
+    {
+        pending.swap(input);
+
+        auto rewindTicks = rewindRequest;
+        rewindRequest = 0;
+
+        lock.unlock();
+
+        if(rewindTicks)
+            applyRewind(rewindTicks);
+
+        for(auto &event : pending)
+        {
+            // only the recorded input is used when replaying
+            if(replaying)
+                continue;
+
+            if(recording)
+                recording->events.push_back({tickCount, event});
+
+            world.handleEvent(event);
+        }
+
+        pending.clear();
+
+        unsigned int scale = timeScale;
+        auto now = Clock::now();
+        auto wakeTime = now + tickLength;
+
+        if(scale == 0)
+        {
+            // as fast as possible, stopping every tick's worth of real time for input and snapshots
+            do
+                tick();
+            while(Clock::now() < wakeTime);
+
+            now = wakeTime = lastTime = Clock::now();
+            accumulator = {};
+        }
+        else
+        {
+            accumulator += (now - lastTime) * scale;
+            lastTime = now;
+
+            for(unsigned int i = 0; accumulator >= tickLength && i < maxCatchUpTicks * scale; i++)
+            {
+                tick();
+                accumulator -= tickLength;
+            }
+
+            if(accumulator >= tickLength)
+            {
+                std::cerr << "Simulation running too slowly, skipping " << std::chrono::duration_cast<std::chrono::milliseconds>(accumulator / scale).count() << "ms\n";
+                accumulator %= tickLength;
+            }
+
+            // fast-forwarding runs a batch of ticks each tick, otherwise
+            // sleep until the tick where something will change
+            if(scale == 1)
+            {
+                auto delay = std::min(world.getNextUpdateDelay(), maxIdleDelay);
+                auto ticks = std::max(1u, (delay + tickMs - 1) / tickMs);
+                wakeTime = now + tickLength * ticks - accumulator;
+            }
+        }
+
+        if(world.getRedrawNeeded())
+        {
+            if(scale == 0)
+                publishSnapshot(now, Clock::duration::zero()); // too fast to interpolate
+            else
+                publishSnapshot(now - accumulator / scale, tickLength / scale);
+        }
+
+        lock.lock();
+        inputCond.wait_until(lock, wakeTime, [this]{return stopping || !input.empty() || rewindRequest;});
+    }
+}
+
+void Simulation::tick()
+{
+    if(replaying)
+    {
+        // stop where the recording did
+        if(tickCount >= recording->length)
+        {
+            replayFinished = true;
+            return;
+        }
+
+        // recorded input, at the same point
+        auto &events = recording->events;
+
+        for(; replayPos < events.size() && events[replayPos].tick <= tickCount; replayPos++)
+        {
+            auto event = events[replayPos].event;
+            world.handleEvent(event);
+        }
+    }
+
+    world.update(tickMs, sound);
+    tickCount++;
+
+    if(autosaveTicks && tickCount % autosaveTicks == 0)
+        autosave();
+
+    if(rewindInterval && tickCount % rewindInterval == 0)
+    {
+        world.saveState(rewindState);
+        rewindBuffer.push(tickCount, rewindState);
+    }
+}
+
+void Simulation::autosave()
+{
+    // don't wait for the last one
+    if(saveWriter.isBusy())
+    {
+        std::cerr << "Skipping autosave, still writing the last one\n";
+        return;
+    }
+
+    world.takeSaveSnapshot(saveWriter.getSnapshot());
+    saveWriter.start(autosavePath);
+}
+
+void Simulation::applyRewind(uint64_t ticks)
+{
+    // the recorded events would no longer match
+    if(recording)
+    {
+        std::cerr << "Can't rewind while recording or replaying\n";
+        return;
+    }
+
+    // as far as possible if asked for too much
+    auto target = std::max(tickCount - std::min(ticks, tickCount), rewindBuffer.getOldestTick());
+
+    uint64_t stateTick;
+
+    if(!rewindBuffer.get(target, rewindState, stateTick))
+    {
+        std::cerr << "Nothing to rewind to\n";
+        return;
+    }
+
+    if(!world.restoreState(rewindState))
+    {
+        std::cerr << "Failed to restore state for tick " << stateTick << "\n";
+        return;
+    }
+
+    std::cout << "Rewound " << (tickCount - stateTick) * tickMs / 1000.0 << "s to tick " << stateTick << "\n";
+
+    // continue from there
+    tickCount = stateTick;
+    rewindBuffer.truncate(stateTick);
+}
+
+void Simulation::publishSnapshot(Clock::time_point time, Clock::duration tickLength)
+{
+    auto &snapshot = snapshots.getBack();
+
+    world.takeSnapshot(snapshot);
+    snapshot.time = time;
+    snapshot.tickLength = tickLength;
+
+    snapshots.publish();
+
+    // wake up the render thread
+    SDL_Event event{};
+    event.type = snapshotEvent;
+    SDL_PushEvent(&event);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <SDL.h>
+
+#include "Recording.hpp"
+#include "RenderSnapshot.hpp"
+#include "Rewind.hpp"
+#include "SaveWriter.hpp"
+#include "TripleBuffer.hpp"
+
+class SoundMixer;
+class World;
+
+// updates the world on its own thread in fixed size ticks
+// the render thread only sees snapshots, and sends input through a queue
+class Simulation final
+{
+public:
+    Simulation(World &world, SoundMixer &sound);
+    ~Simulation();
+
+    // can be started again after stopping (to load another save)
+    void start();
+    void stop();
+
+    // passed to World::handleEvent on the simulation thread before the next tick
+    void queueEvent(const SDL_Event &event);
+
+    // render thread
+    // picks up the latest snapshot, returns true if it's new
+    bool updateSnapshot();
+    const RenderSnapshot &getSnapshot() const;
+
+    // how far through the snapshot's tick to draw moving objects (0-1)
+    float getInterpolation() const;
+
+    // these should be called before start
+
+    // fast-forward, runs this many ticks in the time of one
+    // 0 runs as many as possible
+    void setTimeScale(unsigned int scale);
+
+    // adds handled events to the recording, the length is set when stopping
+    // the seed and date/time need to be filled in by whoever creates the world
+    void record(Recording &recording);
+
+    // uses the recorded events instead of queued ones, stops ticking at the end
+    void replay(Recording &recording);
+
+    bool getReplayFinished() const;
+
+    // saves every interval (skipping one if the last is still being written) and when stopping
+    // only the snapshot is taken on the simulation thread
+    void setAutosave(std::filesystem::path path, uint32_t intervalMs);
+
+    // keeps a world state every interval for lengthMs, for rewinding
+    void setRewind(uint32_t intervalMs, uint32_t lengthMs);
+
+    // goes back (at least) this far, to the nearest kept state
+    // applied on the simulation thread before the next tick, not allowed when recording/replaying
+    void rewind(uint32_t ms);
+
+    // only safe to use when stopped
+    uint64_t getTickCount() const;
+
+    // pushed when there's a new snapshot
+    uint32_t getSnapshotEvent() const;
+
+    static const uint32_t tickMs = 10;
+
+private:
+    void run();
+
+    void tick();
+
+    void autosave();
+
+    void applyRewind(uint64_t ticks);
+
+    void publishSnapshot(std::chrono::steady_clock::time_point time, std::chrono::steady_clock::duration tickLength);
+
+    World &world;
+    SoundMixer &sound;
+
+    std::thread thread;
+
+    std::mutex inputMutex;
+    std::condition_variable inputCond;
+    std::vector<SDL_Event> input;
+    bool stopping = false;
+    uint64_t rewindRequest = 0; // in ticks
+
+    unsigned int timeScale = 1;
+
+    uint64_t tickCount = 0;
+
+    Recording *recording = nullptr;
+    bool replaying = false;
+    size_t replayPos = 0;
+    std::atomic<bool> replayFinished{false};
+
+    std::filesystem::path autosavePath;
+    uint64_t autosaveTicks = 0;
+    SaveWriter saveWriter;
+
+    uint64_t rewindInterval = 0; // in ticks
+    RewindBuffer rewindBuffer;
+    std::vector<uint8_t> rewindState;
+
+    TripleBuffer<RenderSnapshot> snapshots;
+    uint32_t snapshotEvent;
+};
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <vector>
+
+// objects are stored in fixed size pages, so they never move once created
+// handles have a generation so that a stale handle can't find a reused slot
+template<class T, unsigned int pageBits = 8>
+class SlotMap final
+{
+    struct Slot
+    {
+        std::optional<T> value;
+        uint32_t generation = 0;
+        uint32_t nextFree = ~0u;
+    };
+
+public:
+    struct Handle
+    {
+        uint32_t index = ~0u;
+        uint32_t generation = 0;
+
+        bool operator==(const Handle &other) const {return index == other.index && generation == other.generation;}
+        bool operator!=(const Handle &other) const {return !(*this == other);}
+    };
+
+    // skips empty slots, stays valid if objects are added or destroyed
+    template<class MapT, class ValueT>
+    class Iterator final
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = ValueT *;
+        using reference = ValueT &;
+
+        Iterator(MapT *map, uint32_t index) : map(map), index(index)
+        {
+            skipEmpty();
+        }
+
+        ValueT &operator*() const {return *map->getSlot(index).value;}
+        ValueT *operator->() const {return &*map->getSlot(index).value;}
+
+        Iterator &operator++()
+        {
+            index++;
+            skipEmpty();
+            return *this;
+        }
+
+        bool operator==(const Iterator &other) const {return index == other.index;}
+        bool operator!=(const Iterator &other) const {return index != other.index;}
+
+        Handle getHandle() const {return {index, map->getSlot(index).generation};}
+
+    private:
+        void skipEmpty()
+        {
+            while(index < map->capacity && !map->getSlot(index).value)
+                index++;
+        }
+
+        MapT *map;
+        uint32_t index;
+    };
+
+    using iterator = Iterator<SlotMap, T>;
+    using const_iterator = Iterator<const SlotMap, const T>;
+
+    template<class... Args>
+    Handle emplace(Args &&...args)
+    {
+        uint32_t index;
+
+        if(freeHead != ~0u)
+        {
+            index = freeHead;
+            freeHead = getSlot(index).nextFree;
+        }
+        else
+        {
+            if((capacity >> pageBits) == pages.size())
+                pages.emplace_back(std::make_unique<Slot[]>(pageSize));
+
+            index = capacity++;
+        }
+
+        auto &slot = getSlot(index);
+        slot.value.emplace(std::forward<Args>(args)...);
+        count++;
+
+        return {index, slot.generation};
+    }
+
+    // returns false if the handle was already invalid
+    bool destroy(Handle handle)
+    {
+        auto slot = findSlot(handle);
+
+        if(!slot)
+            return false;
+
+        slot->value.reset();
+        slot->generation++;
+        slot->nextFree = freeHead;
+        freeHead = handle.index;
+        count--;
+
+        return true;
+    }
+
+    // allocates pages for this many objects in total
+    void reserve(size_t size)
+    {
+        size_t numPages = (size + pageSize - 1) / pageSize;
+
+        pages.reserve(numPages);
+
+        while(pages.size() < numPages)
+            pages.emplace_back(std::make_unique<Slot[]>(pageSize));
+    }
+
+    // destroys everything, keeping the pages (and generations)
+    void clear()
+    {
+        freeHead = ~0u;
+
+        // build the free list backwards so slots are reused in order
+        for(uint32_t i = capacity; i-- > 0;)
+        {
+            auto &slot = getSlot(i);
+
+            if(slot.value)
+            {
+                slot.value.reset();
+                slot.generation++;
+            }
+
+            slot.nextFree = freeHead;
+            freeHead = i;
+        }
+
+        count = 0;
+    }
+
+    T *get(Handle handle)
+    {
+        auto slot = findSlot(handle);
+        return slot ? &*slot->value : nullptr;
+    }
+
+    const T *get(Handle handle) const
+    {
+        auto slot = const_cast<SlotMap *>(this)->findSlot(handle);
+        return slot ? &*slot->value : nullptr;
+    }
+
+    // raw slot state, for saving and restoring the exact layout (including which slots get reused next)
+    struct SlotState
+    {
+        uint32_t generation;
+        uint32_t nextFree;
+        bool used;
+    };
+
+    uint32_t getCapacity() const {return capacity;}
+    uint32_t getFreeHead() const {return freeHead;}
+
+    SlotState getSlotState(uint32_t index) const
+    {
+        auto &slot = getSlot(index);
+        return {slot.generation, slot.nextFree, slot.value.has_value()};
+    }
+
+    T *getAt(uint32_t index)
+    {
+        if(index >= capacity)
+            return nullptr;
+
+        auto &slot = getSlot(index);
+        return slot.value ? &*slot.value : nullptr;
+    }
+
+    const T *getAt(uint32_t index) const
+    {
+        return const_cast<SlotMap *>(this)->getAt(index);
+    }
+
+    // to restore, call one of these for every slot in [0, capacity) then restoreFreeList
+    template<class... Args>
+    T &emplaceAt(Handle handle, Args &&...args)
+    {
+        grow(handle.index + 1);
+
+        auto &slot = getSlot(handle.index);
+
+        if(slot.value)
+            count--;
+
+        slot.value.reset();
+        slot.value.emplace(std::forward<Args>(args)...);
+        slot.generation = handle.generation;
+        count++;
+
+        return *slot.value;
+    }
+
+    void setGenerationAt(uint32_t index, uint32_t generation)
+    {
+        getSlot(index).generation = generation;
+    }
+
+    void resetAt(uint32_t index, uint32_t generation, uint32_t nextFree)
+    {
+        grow(index + 1);
+
+        auto &slot = getSlot(index);
+
+        if(slot.value)
+        {
+            slot.value.reset();
+            count--;
+        }
+
+        slot.generation = generation;
+        slot.nextFree = nextFree;
+    }
+
+    // destroys anything past the new capacity
+    void restoreFreeList(uint32_t newCapacity, uint32_t newFreeHead)
+    {
+        for(uint32_t i = newCapacity; i < capacity; i++)
+        {
+            auto &slot = getSlot(i);
+
+            if(slot.value)
+            {
+                slot.value.reset();
+                slot.generation++;
+                count--;
+            }
+        }
+
+        capacity = newCapacity;
+        freeHead = newFreeHead;
+    }
+
+    size_t size() const {return count;}
+    bool empty() const {return count == 0;}
+
+    iterator begin() {return {this, 0};}
+    iterator end() {return {this, capacity};}
+    const_iterator begin() const {return {this, 0};}
+    const_iterator end() const {return {this, capacity};}
+
+private:
+    static const uint32_t pageSize = 1 << pageBits;
+
+    Slot &getSlot(uint32_t index) {return pages[index >> pageBits][index & (pageSize - 1)];}
+    const Slot &getSlot(uint32_t index) const {return pages[index >> pageBits][index & (pageSize - 1)];}
+
+    // adds empty slots
+    void grow(uint32_t newCapacity)
+    {
+        while(capacity < newCapacity)
+        {
+            if((capacity >> pageBits) == pages.size())
+                pages.emplace_back(std::make_unique<Slot[]>(pageSize));
+
+            capacity++;
+        }
+    }
+
+    Slot *findSlot(Handle handle)
+    {
+        if(handle.index >= capacity)
+            return nullptr;
+
+        auto &slot = getSlot(handle.index);
+
+        if(slot.generation != handle.generation || !slot.value)
+            return nullptr;
+
+        return &slot;
+    }
+
+    std::vector<std::unique_ptr<Slot[]>> pages;
+
+    uint32_t capacity = 0; // slots in use or free
+    uint32_t count = 0;
+    uint32_t freeHead = ~0u;
+};
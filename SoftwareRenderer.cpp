@@ -0,0 +1,595 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "SoftwareRenderer.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SOFTWARE_RENDERER_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// pixels are ARGB8888
+
+// alpha is 0-256, alpha of src is ignored
+static inline uint32_t blendPixel(uint32_t src, uint32_t dst, uint32_t alpha)
+{
+    uint32_t invAlpha = 256 - alpha;
+
+    uint32_t rb = (((src & 0xFF00FF) * alpha + (dst & 0xFF00FF) * invAlpha) >> 8) & 0xFF00FF;
+    uint32_t g = (((src & 0xFF00) * alpha + (dst & 0xFF00) * invAlpha) >> 8) & 0xFF00;
+    uint32_t a = (alpha * 255 + (dst >> 24) * invAlpha) >> 8;
+
+    return a << 24 | rb | g;
+}
+
+// 0-255 -> 0-256
+static inline uint32_t expandAlpha(uint32_t alpha)
+{
+    return alpha + (alpha >> 7);
+}
+
+#ifdef SOFTWARE_RENDERER_SSE2
+// expand a mask of 16 bytes to 4x 4 32-bit lanes
+static inline void expandMask(__m128i mask8, __m128i mask32[4])
+{
+    __m128i lo = _mm_unpacklo_epi8(mask8, mask8);
+    __m128i hi = _mm_unpackhi_epi8(mask8, mask8);
+
+    mask32[0] = _mm_unpacklo_epi16(lo, lo);
+    mask32[1] = _mm_unpackhi_epi16(lo, lo);
+    mask32[2] = _mm_unpacklo_epi16(hi, hi);
+    mask32[3] = _mm_unpackhi_epi16(hi, hi);
+}
+
+// look up 4 indices
+static inline __m128i lookupPalette4(const uint8_t *src, const uint32_t *palette)
+{
+    return _mm_setr_epi32(
+        static_cast<int>(palette[src[0]]), static_cast<int>(palette[src[1]]),
+        static_cast<int>(palette[src[2]]), static_cast<int>(palette[src[3]])
+    );
+}
+
+// same as blendPixel, alpha/invAlpha are 16-bit lanes
+static inline __m128i blend4(__m128i src, __m128i dst, __m128i alpha, __m128i invAlpha)
+{
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(src, zero), alpha), _mm_mullo_epi16(_mm_unpacklo_epi8(dst, zero), invAlpha));
+    __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(src, zero), alpha), _mm_mullo_epi16(_mm_unpackhi_epi8(dst, zero), invAlpha));
+
+    return _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+}
+
+// dst = mask ? keep : value
+static inline void storeMasked(uint32_t *dst, __m128i value, __m128i keepMask)
+{
+    auto ptr = reinterpret_cast<__m128i *>(dst);
+    __m128i old = _mm_loadu_si128(ptr);
+    _mm_storeu_si128(ptr, _mm_or_si128(_mm_and_si128(keepMask, old), _mm_andnot_si128(keepMask, value)));
+}
+#endif
+
+// palette expansion, index 0 is transparent
+static void copyIndexedSpan(uint32_t *dst, const uint8_t *src, const uint32_t *palette, int count)
+{
+    int i = 0;
+
+#if defined(__AVX2__)
+    for(; i + 8 <= count; i += 8)
+    {
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i)));
+        __m256i transparent = _mm256_cmpeq_epi32(index, _mm256_setzero_si256());
+
+        if(_mm256_movemask_epi8(transparent) == -1)
+            continue;
+
+        __m256i colours = _mm256_i32gather_epi32(reinterpret_cast<const int *>(palette), index, 4);
+
+        auto ptr = reinterpret_cast<__m256i *>(dst + i);
+        _mm256_storeu_si256(ptr, _mm256_blendv_epi8(colours, _mm256_loadu_si256(ptr), transparent));
+    }
+#elif defined(SOFTWARE_RENDERER_SSE2)
+    for(; i + 16 <= count; i += 16)
+    {
+        __m128i transparent = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), _mm_setzero_si128());
+        int mask = _mm_movemask_epi8(transparent);
+
+        if(mask == 0xFFFF)
+            continue;
+
+        if(mask == 0)
+        {
+            // fully opaque
+            for(int j = 0; j < 16; j += 4)
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + j), lookupPalette4(src + i + j, palette));
+
+            continue;
+        }
+
+        __m128i transparent32[4];
+        expandMask(transparent, transparent32);
+
+        for(int j = 0; j < 4; j++)
+            storeMasked(dst + i + j * 4, lookupPalette4(src + i + j * 4, palette), transparent32[j]);
+    }
+#endif
+
+    for(; i < count; i++)
+    {
+        if(src[i])
+            dst[i] = palette[src[i]];
+    }
+}
+
+// same as above, but with constant alpha
+static void blendIndexedSpan(uint32_t *dst, const uint8_t *src, const uint32_t *palette, int count, uint32_t alpha)
+{
+    alpha = expandAlpha(alpha);
+
+    int i = 0;
+
+#ifdef SOFTWARE_RENDERER_SSE2
+    __m128i alpha16 = _mm_set1_epi16(static_cast<short>(alpha));
+    __m128i invAlpha16 = _mm_set1_epi16(static_cast<short>(256 - alpha));
+
+    for(; i + 16 <= count; i += 16)
+    {
+        __m128i transparent = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), _mm_setzero_si128());
+
+        if(_mm_movemask_epi8(transparent) == 0xFFFF)
+            continue;
+
+        __m128i transparent32[4];
+        expandMask(transparent, transparent32);
+
+        for(int j = 0; j < 4; j++)
+        {
+            auto ptr = dst + i + j * 4;
+            __m128i blended = blend4(lookupPalette4(src + i + j * 4, palette), _mm_loadu_si128(reinterpret_cast<__m128i *>(ptr)), alpha16, invAlpha16);
+            storeMasked(ptr, blended, transparent32[j]);
+        }
+    }
+#endif
+
+    for(; i < count; i++)
+    {
+        if(src[i])
+            dst[i] = blendPixel(palette[src[i]], dst[i], alpha);
+    }
+}
+
+// ARGB source, per-pixel alpha
+static void blendSpan(uint32_t *dst, const uint32_t *src, int count, uint32_t alpha)
+{
+    for(int i = 0; i < count; i++)
+    {
+        uint32_t srcAlpha = src[i] >> 24;
+
+        if(alpha != 255)
+            srcAlpha = srcAlpha * alpha / 255;
+
+        if(srcAlpha == 0)
+            continue;
+
+        if(srcAlpha == 255)
+            dst[i] = src[i];
+        else
+            dst[i] = blendPixel(src[i], dst[i], expandAlpha(srcAlpha));
+    }
+}
+
+SoftwareRenderer::SoftwareRenderer(SDL_Renderer *renderer, unsigned int numThreads) : renderer(renderer), pool(numThreads)
+{
+    updateOutputSize();
+}
+
+std::shared_ptr<Texture> SoftwareRenderer::createTexture(SDL_Surface *surface)
+{
+    auto texture = std::make_shared<Texture>();
+    texture->width = surface->w;
+    texture->height = surface->h;
+
+    // indexed bitmaps use index 0 as transparent
+    // TODO: is this always true?
+    if(SDL_PIXELTYPE(surface->format->format) == SDL_PIXELTYPE_INDEX8)
+    {
+        // keep the indices
+        texture->indices.resize(surface->w * surface->h);
+
+        SDL_LockSurface(surface);
+
+        for(int y = 0; y < surface->h; y++)
+        {
+            auto row = static_cast<uint8_t *>(surface->pixels) + y * surface->pitch;
+            memcpy(texture->indices.data() + y * surface->w, row, surface->w);
+        }
+
+        SDL_UnlockSurface(surface);
+
+        // always 256 entries so that any index is valid
+        texture->palette.resize(256, 0);
+
+        auto palette = surface->format->palette;
+        int numColours = std::min(256, palette->ncolors);
+
+        for(int i = 1; i < numColours; i++)
+        {
+            auto &col = palette->colors[i];
+            texture->palette[i] = 0xFF000000 | col.r << 16 | col.g << 8 | col.b;
+        }
+    }
+    else
+    {
+        auto converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+
+        if(!converted)
+            return nullptr;
+
+        texture->pixels.resize(converted->w * converted->h);
+
+        SDL_LockSurface(converted);
+
+        for(int y = 0; y < converted->h; y++)
+        {
+            auto row = static_cast<uint8_t *>(converted->pixels) + y * converted->pitch;
+            memcpy(texture->pixels.data() + y * converted->w, row, converted->w * 4);
+        }
+
+        SDL_UnlockSurface(converted);
+        SDL_FreeSurface(converted);
+    }
+
+    return texture;
+}
+
+bool SoftwareRenderer::getTargetsSupported() const
+{
+    return true;
+}
+
+std::shared_ptr<Texture> SoftwareRenderer::createTarget(int width, int height)
+{
+    auto texture = std::make_shared<Texture>();
+    texture->width = width;
+    texture->height = height;
+    texture->pixels.resize(width * height);
+
+    return texture;
+}
+
+void SoftwareRenderer::setTarget(std::shared_ptr<Texture> target)
+{
+    if(target == this->target)
+        return;
+
+    // finish drawing to the old target, it might be used as a source next
+    flush();
+
+    // targets have their own clip rect
+    if(!this->target)
+        outputClipRect = clipRect;
+
+    this->target = std::move(target);
+
+    if(this->target)
+        clipRect = {0, 0, 0, 0};
+    else
+        clipRect = outputClipRect;
+}
+
+std::shared_ptr<Texture> SoftwareRenderer::getTarget() const
+{
+    return target;
+}
+
+void SoftwareRenderer::setClipRect(const SDL_Rect *rect)
+{
+    if(rect && rect->w > 0 && rect->h > 0)
+        clipRect = *rect;
+    else
+        clipRect = {0, 0, 0, 0};
+}
+
+void SoftwareRenderer::getClipRect(SDL_Rect &rect) const
+{
+    rect = clipRect;
+}
+
+void SoftwareRenderer::setDrawColour(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+    drawColour = a << 24 | r << 16 | g << 8 | b;
+}
+
+void SoftwareRenderer::clear()
+{
+    // anything before this would be overwritten anyway
+    commands.clear();
+
+    if(!target)
+        updateOutputSize();
+
+    auto &dstTex = getCurrentTarget();
+
+    DrawCommand command{};
+    command.type = DrawCommand::Type::Fill;
+    command.area = {0, 0, dstTex.width, dstTex.height};
+    command.colour = drawColour;
+    commands.push_back(command);
+}
+
+void SoftwareRenderer::drawPoint(int x, int y)
+{
+    fillRect({x, y, 1, 1});
+}
+
+void SoftwareRenderer::drawRect(const SDL_Rect &rect)
+{
+    if(rect.w <= 0 || rect.h <= 0)
+        return;
+
+    fillRect({rect.x, rect.y, rect.w, 1});
+
+    if(rect.h > 1)
+        fillRect({rect.x, rect.y + rect.h - 1, rect.w, 1});
+
+    if(rect.h > 2)
+    {
+        fillRect({rect.x, rect.y + 1, 1, rect.h - 2});
+
+        if(rect.w > 1)
+            fillRect({rect.x + rect.w - 1, rect.y + 1, 1, rect.h - 2});
+    }
+}
+
+void SoftwareRenderer::copy(const Texture &texture, const SDL_Rect *srcRect, const SDL_Rect *dstRect, bool flipX)
+{
+    bool indexed = !texture.indices.empty();
+
+    if(!indexed && texture.pixels.empty())
+        return;
+
+    auto &dstTex = getCurrentTarget();
+
+    SDL_Rect src = srcRect ? *srcRect : SDL_Rect{0, 0, texture.width, texture.height};
+    SDL_Rect dst = dstRect ? *dstRect : SDL_Rect{0, 0, dstTex.width, dstTex.height};
+
+    if(src.w <= 0 || src.h <= 0 || dst.w <= 0 || dst.h <= 0)
+        return;
+
+    // clip source to texture, adjusting the destination to match
+    SDL_Rect texRect{0, 0, texture.width, texture.height};
+    SDL_Rect clippedSrc;
+
+    if(!SDL_IntersectRect(&src, &texRect, &clippedSrc))
+        return;
+
+    if(clippedSrc.w != src.w || clippedSrc.h != src.h)
+    {
+        int x0 = dst.x + (clippedSrc.x - src.x) * dst.w / src.w;
+        int y0 = dst.y + (clippedSrc.y - src.y) * dst.h / src.h;
+        int x1 = dst.x + (clippedSrc.x + clippedSrc.w - src.x) * dst.w / src.w;
+        int y1 = dst.y + (clippedSrc.y + clippedSrc.h - src.y) * dst.h / src.h;
+
+        dst = {x0, y0, x1 - x0, y1 - y0};
+        src = clippedSrc;
+    }
+
+    // clip destination
+    auto clipArea = getClipArea();
+
+    DrawCommand command{};
+    command.type = DrawCommand::Type::Copy;
+
+    if(!SDL_IntersectRect(&dst, &clipArea, &command.area))
+        return;
+
+    command.texture = &texture;
+    command.src = src;
+    command.dst = dst;
+    command.flipX = flipX;
+    commands.push_back(command);
+}
+
+void SoftwareRenderer::present()
+{
+    flush();
+
+    if(!outputTexture)
+        return;
+
+    // single upload for the whole frame
+    SDL_UpdateTexture(outputTexture.get(), nullptr, framebuffer.pixels.data(), framebuffer.width * 4);
+
+    SDL_RenderCopy(renderer, outputTexture.get(), nullptr, nullptr);
+    SDL_RenderPresent(renderer);
+}
+
+void SoftwareRenderer::updateOutputSize()
+{
+    int w, h;
+    if(SDL_GetRendererOutputSize(renderer, &w, &h) != 0)
+        return;
+
+    if(outputTexture && w == framebuffer.width && h == framebuffer.height)
+        return;
+
+    framebuffer.width = w;
+    framebuffer.height = h;
+    framebuffer.pixels.resize(w * h);
+
+    auto texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, w, h);
+
+    if(!texture)
+    {
+        std::cerr << "Failed to create output texture (" << SDL_GetError() << ")\n";
+        outputTexture.reset();
+        return;
+    }
+
+    outputTexture = std::shared_ptr<SDL_Texture>(texture, SDL_DestroyTexture);
+}
+
+Texture &SoftwareRenderer::getCurrentTarget()
+{
+    return target ? *target : framebuffer;
+}
+
+SDL_Rect SoftwareRenderer::getClipArea()
+{
+    auto &dstTex = getCurrentTarget();
+    SDL_Rect bounds{0, 0, dstTex.width, dstTex.height};
+
+    if(!clipRect.w || !clipRect.h)
+        return bounds;
+
+    SDL_Rect area;
+    if(!SDL_IntersectRect(&clipRect, &bounds, &area))
+        return {0, 0, 0, 0};
+
+    return area;
+}
+
+void SoftwareRenderer::fillRect(const SDL_Rect &rect)
+{
+    auto clipArea = getClipArea();
+
+    DrawCommand command{};
+    command.type = DrawCommand::Type::Fill;
+
+    if(!SDL_IntersectRect(&rect, &clipArea, &command.area))
+        return;
+
+    command.colour = drawColour;
+    commands.push_back(command);
+}
+
+void SoftwareRenderer::flush()
+{
+    if(commands.empty())
+        return;
+
+    auto &dstTex = getCurrentTarget();
+
+    int tilesX = (dstTex.width + tileSize - 1) / tileSize;
+    int tilesY = (dstTex.height + tileSize - 1) / tileSize;
+    int numTiles = tilesX * tilesY;
+
+    if(numTiles <= 1 || pool.getNumThreads() == 1)
+    {
+        // no point binning anything
+        for(auto &command : commands)
+            rasterise(command, dstTex, command.area);
+
+        commands.clear();
+        return;
+    }
+
+    // bin commands into tiles, keeping the order within each tile
+    if(static_cast<int>(tileCommands.size()) < numTiles)
+        tileCommands.resize(numTiles);
+
+    for(int i = 0; i < numTiles; i++)
+        tileCommands[i].clear();
+
+    for(uint32_t i = 0; i < commands.size(); i++)
+    {
+        auto &area = commands[i].area;
+
+        int x0 = area.x / tileSize, x1 = (area.x + area.w - 1) / tileSize;
+        int y0 = area.y / tileSize, y1 = (area.y + area.h - 1) / tileSize;
+
+        for(int y = y0; y <= y1; y++)
+        {
+            for(int x = x0; x <= x1; x++)
+                tileCommands[x + y * tilesX].push_back(i);
+        }
+    }
+
+    // each tile only touches its own pixels, so no locking needed
+    pool.parallelFor(numTiles, [this, &dstTex, tilesX](unsigned int tile)
+    {
+        SDL_Rect tileRect{static_cast<int>(tile % tilesX) * tileSize, static_cast<int>(tile / tilesX) * tileSize, tileSize, tileSize};
+
+        for(auto i : tileCommands[tile])
+        {
+            auto &command = commands[i];
+
+            SDL_Rect area;
+            if(SDL_IntersectRect(&command.area, &tileRect, &area))
+                rasterise(command, dstTex, area);
+        }
+    });
+
+    commands.clear();
+}
+
+void SoftwareRenderer::rasterise(const DrawCommand &command, Texture &dstTex, const SDL_Rect &area)
+{
+    if(command.type == DrawCommand::Type::Fill)
+    {
+        for(int y = area.y; y < area.y + area.h; y++)
+        {
+            auto dstRow = dstTex.pixels.data() + area.x + y * dstTex.width;
+            std::fill(dstRow, dstRow + area.w, command.colour);
+        }
+        return;
+    }
+
+    auto &texture = *command.texture;
+    auto &src = command.src;
+    auto &dst = command.dst;
+
+    bool indexed = !texture.indices.empty();
+    bool scaled = src.w != dst.w || src.h != dst.h;
+
+    for(int y = area.y; y < area.y + area.h; y++)
+    {
+        int srcY = src.y + (y - dst.y) * src.h / dst.h;
+        auto dstRow = dstTex.pixels.data() + area.x + y * dstTex.width;
+
+        if(!scaled && !command.flipX)
+        {
+            // fast path, spans
+            int srcOffset = src.x + (area.x - dst.x) + srcY * texture.width;
+
+            if(!indexed)
+                blendSpan(dstRow, texture.pixels.data() + srcOffset, area.w, texture.alpha);
+            else if(texture.alpha == 255)
+                copyIndexedSpan(dstRow, texture.indices.data() + srcOffset, texture.palette.data(), area.w);
+            else
+                blendIndexedSpan(dstRow, texture.indices.data() + srcOffset, texture.palette.data(), area.w, texture.alpha);
+
+            continue;
+        }
+
+        // scaled/flipped, one pixel at a time
+        for(int x = 0; x < area.w; x++)
+        {
+            int srcX = (area.x + x - dst.x) * src.w / dst.w;
+            srcX = src.x + (command.flipX ? src.w - 1 - srcX : srcX);
+
+            int srcOffset = srcX + srcY * texture.width;
+
+            if(indexed)
+            {
+                auto index = texture.indices[srcOffset];
+
+                if(!index)
+                    continue;
+
+                if(texture.alpha == 255)
+                    dstRow[x] = texture.palette[index];
+                else
+                    dstRow[x] = blendPixel(texture.palette[index], dstRow[x], expandAlpha(texture.alpha));
+            }
+            else
+                blendSpan(dstRow + x, texture.pixels.data() + srcOffset, 1, texture.alpha);
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+
+#include "Renderer.hpp"
+#include "ThreadPool.hpp"
+
+// renders into a framebuffer on the CPU, then uploads it in one go
+// (for when SDL would fall back to its own software renderer)
+// textures are kept as 8-bit palette indices where possible
+// draws are recorded and split into tiles across threads when the target is finished with
+// (textures need to stay alive until then)
+class SoftwareRenderer final : public Renderer
+{
+public:
+    SoftwareRenderer(SDL_Renderer *renderer, unsigned int numThreads = 0);
+
+    std::shared_ptr<Texture> createTexture(SDL_Surface *surface) override;
+
+    bool getTargetsSupported() const override;
+    std::shared_ptr<Texture> createTarget(int width, int height) override;
+    void setTarget(std::shared_ptr<Texture> target) override;
+    std::shared_ptr<Texture> getTarget() const override;
+
+    void setClipRect(const SDL_Rect *rect) override;
+    void getClipRect(SDL_Rect &rect) const override;
+
+    void setDrawColour(uint8_t r, uint8_t g, uint8_t b, uint8_t a) override;
+
+    void clear() override;
+    void drawPoint(int x, int y) override;
+    void drawRect(const SDL_Rect &rect) override;
+    void fillRect(const SDL_Rect &rect) override;
+
+    void copy(const Texture &texture, const SDL_Rect *srcRect, const SDL_Rect *dstRect, bool flipX = false) override;
+
+    void present() override;
+
+private:
+    struct DrawCommand
+    {
+        enum class Type
+        {
+            Fill,
+            Copy
+        };
+
+        Type type;
+        SDL_Rect area; // clipped destination
+
+        // copy
+        const Texture *texture;
+        SDL_Rect src, dst;
+        bool flipX;
+
+        // fill
+        uint32_t colour;
+    };
+
+    static const int tileSize = 64;
+
+    void flush();
+    static void rasterise(const DrawCommand &command, Texture &dstTex, const SDL_Rect &area);
+
+    void updateOutputSize();
+
+    Texture &getCurrentTarget();
+    SDL_Rect getClipArea();
+
+    SDL_Renderer *renderer; // used to present
+
+    std::shared_ptr<SDL_Texture> outputTexture;
+    Texture framebuffer;
+
+    std::shared_ptr<Texture> target;
+
+    SDL_Rect clipRect{0, 0, 0, 0};
+    SDL_Rect outputClipRect{0, 0, 0, 0}; // saved while drawing to a target
+
+    uint32_t drawColour = 0xFF000000;
+
+    std::vector<DrawCommand> commands; // for the current target
+    std::vector<std::vector<uint32_t>> tileCommands;
+
+    ThreadPool pool;
+};
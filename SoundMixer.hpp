@@ -1,32 +1,21 @@
 #pragma once
 
-#include <map>
+#include <cstdint>
+#include <memory>
 
 #include <SDL_mixer.h>
 
-#include "SoundLoader.hpp"
-
-class SoundMixer final
+// interface for playing object sounds
+class SoundMixer
 {
 public:
-    SoundMixer(FileLoader &fileLoader);
-
-    uint32_t playSound(const std::shared_ptr<Mix_Chunk> &sound, int priority);
-
-    bool isSoundPlaying(uint32_t id) const;
-
-    SoundLoader &getLoader();
-
-private:
-    SoundLoader loader;
+    virtual ~SoundMixer() = default;
 
-    struct SoundInfo
-    {
-        std::shared_ptr<Mix_Chunk> chunk;
-        uint32_t id;
-    };
+    // null if sound isn't available
+    virtual std::shared_ptr<Mix_Chunk> loadSound(int32_t id) = 0;
 
-    uint32_t nextSoundId = 0;
+    // returns an id for isSoundPlaying, ~0 if it couldn't be played
+    virtual uint32_t playSound(const std::shared_ptr<Mix_Chunk> &sound, int priority) = 0;
 
-    std::map<int, SoundInfo> playingSounds;
-};
\ No newline at end of file
+    virtual bool isSoundPlaying(uint32_t id) const = 0;
+};
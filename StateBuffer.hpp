@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// binary serialisation of simulation state (for rewinding)
+// values are copied as-is, so states are only valid for the same build
+class StateWriter final
+{
+public:
+    StateWriter(std::vector<uint8_t> &data) : data(data) {}
+
+    template<class T>
+    void write(const T &value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        auto offset = data.size();
+        data.resize(offset + sizeof(T));
+        memcpy(data.data() + offset, &value, sizeof(T));
+    }
+
+    template<class T>
+    void writeVector(const std::vector<T> &values)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        write(uint32_t(values.size()));
+
+        auto offset = data.size();
+        data.resize(offset + values.size() * sizeof(T));
+        memcpy(data.data() + offset, values.data(), values.size() * sizeof(T));
+    }
+
+    void writeString(const std::string &value)
+    {
+        write(uint32_t(value.size()));
+
+        auto offset = data.size();
+        data.resize(offset + value.size());
+        memcpy(data.data() + offset, value.data(), value.size());
+    }
+
+private:
+    std::vector<uint8_t> &data;
+};
+
+class StateReader final
+{
+public:
+    StateReader(const std::vector<uint8_t> &data) : ptr(data.data()), end(data.data() + data.size()) {}
+
+    // false if there isn't enough data left
+    template<class T>
+    bool read(T &value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        if(size_t(end - ptr) < sizeof(T))
+            return false;
+
+        memcpy(&value, ptr, sizeof(T));
+        ptr += sizeof(T);
+        return true;
+    }
+
+    template<class T>
+    bool readVector(std::vector<T> &values)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        uint32_t size;
+
+        if(!read(size) || size_t(end - ptr) / sizeof(T) < size)
+            return false;
+
+        values.resize(size);
+        memcpy(values.data(), ptr, size * sizeof(T));
+        ptr += size * sizeof(T);
+        return true;
+    }
+
+    bool readString(std::string &value)
+    {
+        uint32_t size;
+
+        if(!read(size) || size_t(end - ptr) < size)
+            return false;
+
+        value.assign(reinterpret_cast<const char *>(ptr), size);
+        ptr += size;
+        return true;
+    }
+
+    bool atEnd() const {return ptr == end;}
+
+private:
+    const uint8_t *ptr, *end;
+};
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <SDL.h>
+
+// image created by one of the renderers
+struct Texture
+{
+    int width = 0, height = 0;
+
+    uint8_t alpha = 255; // applied to the whole texture (semi-transparent objects)
+
+    // SDLRenderer
+    // textures are created from the surface when first drawn, on the render thread
+    mutable std::shared_ptr<SDL_Texture> sdlTexture;
+    mutable std::shared_ptr<SDL_Surface> surface;
+
+    // SoftwareRenderer
+    // either 8-bit indices + palette with index 0 transparent, or ARGB8888 pixels
+    std::vector<uint8_t> indices;
+    std::vector<uint32_t> palette;
+    std::vector<uint32_t> pixels;
+};
@@ -7,16 +7,22 @@ TextureLoader::TextureLoader(FileLoader &fileLoader) : fileLoader(fileLoader)
 {
 }
 
-std::shared_ptr<SDL_Texture> TextureLoader::loadTexture(std::string_view relPath)
+std::shared_ptr<Texture> TextureLoader::loadTexture(std::string_view relPath)
 {
-    auto tex = findTexture(relPath);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        auto tex = findTexture(relPath);
 
-    if(tex)
-        return tex;
+        if(tex)
+            return tex;
+    }
 
     if(!renderer)
         return nullptr;
 
+    // reading/decoding can happen on multiple threads at once
+
     auto stream = fileLoader.openResourceFile(relPath);
 
     if(!stream)
@@ -34,32 +40,29 @@ std::shared_ptr<SDL_Texture> TextureLoader::loadTexture(std::string_view relPath
         return nullptr;
     }
 
-    // indexed bitmaps use index 0 as transparent
-    // TODO: is this always true?
-    if(SDL_PIXELTYPE(surface->format->format) == SDL_PIXELTYPE_INDEX8)
-    {
-        // set index 0 to transparent and convert to RGBA
-        SDL_Colour trans{0, 0, 0, 0};
-        SDL_SetPaletteColors(surface->format->palette, &trans, 0, 1);
+    // creating textures can't
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // another thread might have got here first
+    auto existing = findTexture(relPath);
 
-        auto newSurf = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+    if(existing)
+    {
         SDL_FreeSurface(surface);
-        surface = newSurf;
+        return existing;
     }
 
     // create texture
-    auto texture = SDL_CreateTextureFromSurface(renderer, surface);
+    auto texPtr = renderer->createTexture(surface);
 
     SDL_FreeSurface(surface);
 
-    if(!texture)
+    if(!texPtr)
     {
         std::cerr << "Failed to create texture from " << relPath << "(" << SDL_GetError() << ")" << "\n";
         return nullptr;
     }
 
-    std::shared_ptr<SDL_Texture> texPtr(texture, SDL_DestroyTexture);
-
     // save
     auto res = textures.emplace(relPath, texPtr);
 
@@ -69,7 +72,7 @@ std::shared_ptr<SDL_Texture> TextureLoader::loadTexture(std::string_view relPath
     return texPtr;
 }
 
-std::shared_ptr<SDL_Texture> TextureLoader::loadTexture(int32_t id)
+std::shared_ptr<Texture> TextureLoader::loadTexture(int32_t id)
 {
     // this would use openResourceFile(id), but we need to normalise id/path for the cache
     auto path = fileLoader.lookupId(id, ".bmp");
@@ -80,12 +83,12 @@ std::shared_ptr<SDL_Texture> TextureLoader::loadTexture(int32_t id)
     return loadTexture(path.value());
 }
 
-void TextureLoader::setRenderer(SDL_Renderer *renderer)
+void TextureLoader::setRenderer(Renderer *renderer)
 {
     this->renderer = renderer;
 }
 
-std::shared_ptr<SDL_Texture> TextureLoader::findTexture(std::string_view relPath) const
+std::shared_ptr<Texture> TextureLoader::findTexture(std::string_view relPath) const
 {
     auto it = textures.find(relPath);
 
@@ -1,25 +1,30 @@
 #pragma once
 
+#include <mutex>
+
 #include <SDL.h>
 
 #include "FileLoader.hpp"
+#include "Renderer.hpp"
 
+// loads can happen from any thread
 class TextureLoader final
 {
 public:
     TextureLoader(FileLoader &fileLoader);
 
-    std::shared_ptr<SDL_Texture> loadTexture(std::string_view relPath);
-    std::shared_ptr<SDL_Texture> loadTexture(int32_t id);
+    std::shared_ptr<Texture> loadTexture(std::string_view relPath);
+    std::shared_ptr<Texture> loadTexture(int32_t id);
 
-    void setRenderer(SDL_Renderer *renderer);
+    void setRenderer(Renderer *renderer);
 
 private:
-    std::shared_ptr<SDL_Texture> findTexture(std::string_view relPath) const;
+    std::shared_ptr<Texture> findTexture(std::string_view relPath) const;
 
     FileLoader &fileLoader;
 
-    SDL_Renderer *renderer = nullptr;
+    Renderer *renderer = nullptr;
 
-    std::map<std::string, std::weak_ptr<SDL_Texture>, std::less<>> textures;
+    std::mutex mutex;
+    std::map<std::string, std::weak_ptr<Texture>, std::less<>> textures;
 };
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include <algorithm>
+
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+{
+    if(!numThreads)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    // the calling thread counts as one
+    for(unsigned int i = 1; i < numThreads; i++)
+        workers.emplace_back(&ThreadPool::workerMain, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(mutex);
+        quit = true;
+    }
+
+    jobCond.notify_all();
+
+    for(auto &thread : workers)
+        thread.join();
+}
+
+void ThreadPool::parallelFor(unsigned int count, const std::function<void(unsigned int)> &func)
+{
+    if(!count)
+        return;
+
+    // not worth waking anything up
+    if(count == 1 || workers.empty())
+    {
+        for(unsigned int i = 0; i < count; i++)
+            func(i);
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex);
+        jobFunc = &func;
+        jobCount = count;
+        nextIndex = 0;
+        activeWorkers = workers.size();
+        jobId++;
+    }
+
+    jobCond.notify_all();
+
+    runJob();
+
+    // wait for the workers to finish
+    std::unique_lock lock(mutex);
+    doneCond.wait(lock, [this]{return activeWorkers == 0;});
+
+    jobFunc = nullptr;
+}
+
+unsigned int ThreadPool::getNumThreads() const
+{
+    return workers.size() + 1;
+}
+
+void ThreadPool::workerMain()
+{
+    uint32_t lastJob = 0;
+
+    while(true)
+    {
+        {
+            std::unique_lock lock(mutex);
+            jobCond.wait(lock, [this, lastJob]{return quit || jobId != lastJob;});
+
+            if(quit)
+                return;
+
+            lastJob = jobId;
+        }
+
+        runJob();
+
+        {
+            std::lock_guard lock(mutex);
+            activeWorkers--;
+        }
+
+        doneCond.notify_one();
+    }
+}
+
+void ThreadPool::runJob()
+{
+    while(true)
+    {
+        unsigned int index = nextIndex++;
+
+        if(index >= jobCount)
+            break;
+
+        (*jobFunc)(index);
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// simple pool for splitting work across cores
+class ThreadPool final
+{
+public:
+    ThreadPool(unsigned int numThreads = 0); // 0 = one per core
+    ThreadPool(ThreadPool &) = delete;
+    ~ThreadPool();
+
+    // calls func(i) for every i in [0, count) and waits for them all to finish
+    // the calling thread also does some of the work
+    void parallelFor(unsigned int count, const std::function<void(unsigned int)> &func);
+
+    unsigned int getNumThreads() const;
+
+private:
+    void workerMain();
+    void runJob();
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable jobCond, doneCond;
+
+    bool quit = false;
+
+    // current job
+    uint32_t jobId = 0;
+    const std::function<void(unsigned int)> *jobFunc = nullptr;
+    unsigned int jobCount = 0;
+    std::atomic<unsigned int> nextIndex{0};
+    unsigned int activeWorkers = 0;
+};
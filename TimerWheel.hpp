@@ -0,0 +1,228 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// hierarchical timer wheel with 1ms ticks
+// the cost of advancing depends on how many timers fire, not how many exist
+// (timers can't be cancelled, check if the data is still valid when they fire instead)
+template<class T>
+class TimerWheel final
+{
+public:
+    struct Timer
+    {
+        uint64_t expiry;
+        T data;
+    };
+
+    // 0 fires on the next advance
+    void schedule(uint32_t delayMs, const T &data)
+    {
+        scheduleAt(now + delayMs, data);
+    }
+
+    // anything at or before the current time fires on the next advance
+    void scheduleAt(uint64_t time, const T &data)
+    {
+        count++;
+
+        if(time <= now)
+        {
+            due.push_back({time, data});
+            return;
+        }
+
+        place({time, data});
+    }
+
+    // fired timers are appended in expiry order
+    void advance(uint32_t deltaMs, std::vector<Timer> &fired)
+    {
+        for(auto &entry : due)
+            fired.push_back(entry);
+
+        count -= due.size();
+        due.clear();
+
+        uint64_t target = now + deltaMs;
+
+        while(now < target)
+        {
+            if(!count)
+            {
+                now = target;
+                break;
+            }
+
+            // nothing in the lowest level, skip to the next cascade
+            if(!bitmaps[0])
+            {
+                uint64_t nextWrap = (now | slotMask) + 1;
+
+                if(nextWrap > target)
+                {
+                    now = target;
+                    break;
+                }
+
+                now = nextWrap - 1;
+            }
+
+            now++;
+
+            // move timers down from the higher levels
+            for(int level = 1; level < numLevels; level++)
+            {
+                if((now >> ((level - 1) * slotBits)) & slotMask)
+                    break;
+
+                cascade(level, (now >> (level * slotBits)) & slotMask);
+            }
+
+            auto slot = now & slotMask;
+
+            if(!(bitmaps[0] & (uint64_t(1) << slot)))
+                continue;
+
+            auto &entries = slots[0][slot];
+
+            for(auto &entry : entries)
+                fired.push_back(entry);
+
+            count -= entries.size();
+            entries.clear();
+            bitmaps[0] &= ~(uint64_t(1) << slot);
+        }
+    }
+
+    // lower bound on the time until something fires, ~0 if nothing is scheduled
+    uint32_t getNextDelay() const
+    {
+        if(!due.empty())
+            return 0;
+
+        if(!count)
+            return ~0u;
+
+        uint64_t delay = ~uint64_t(0);
+
+        for(int level = 0; level < numLevels; level++)
+        {
+            if(!bitmaps[level])
+                continue;
+
+            int shift = level * slotBits;
+            auto current = (now >> shift) & slotMask;
+
+            // first used slot after the current one
+            for(unsigned int i = 1; i <= numSlots; i++)
+            {
+                auto slot = (current + i) & slotMask;
+
+                if(bitmaps[level] & (uint64_t(1) << slot))
+                {
+                    // start of that slot
+                    uint64_t start = ((now >> shift) + i) << shift;
+                    delay = std::min(delay, start - now);
+                    break;
+                }
+            }
+        }
+
+        return static_cast<uint32_t>(std::min(delay, uint64_t(~0u)));
+    }
+
+    void clear()
+    {
+        for(auto &level : slots)
+        {
+            for(auto &slot : level)
+                slot.clear();
+        }
+
+        for(auto &bitmap : bitmaps)
+            bitmap = 0;
+
+        due.clear();
+        count = 0;
+    }
+
+    // everything scheduled, for saving
+    void getTimers(std::vector<Timer> &timers) const
+    {
+        timers.insert(timers.end(), due.begin(), due.end());
+
+        for(int level = 0; level < numLevels; level++)
+        {
+            for(auto &slot : slots[level])
+                timers.insert(timers.end(), slot.begin(), slot.end());
+        }
+    }
+
+    // replaces everything with saved timers
+    void restore(uint64_t time, const std::vector<Timer> &timers)
+    {
+        clear();
+        now = time;
+
+        for(auto &timer : timers)
+            scheduleAt(timer.expiry, timer.data);
+    }
+
+    size_t size() const {return count;}
+
+    uint64_t getTime() const {return now;}
+
+private:
+    using Entry = Timer;
+
+    static const int slotBits = 6;
+    static const unsigned int numSlots = 1 << slotBits;
+    static const uint64_t slotMask = numSlots - 1;
+    static const int numLevels = 4; // ~4.6 hours
+
+    void place(Entry &&entry)
+    {
+        uint64_t delta = entry.expiry - now;
+
+        int level = 0;
+        while(level < numLevels - 1 && delta >= (uint64_t(1) << ((level + 1) * slotBits)))
+            level++;
+
+        // too far ahead, park in the last slot that will be reached and place again when it cascades
+        uint64_t expiry = entry.expiry;
+        uint64_t maxDelta = (uint64_t(1) << (numLevels * slotBits)) - 1;
+
+        if(delta > maxDelta)
+            expiry = now + maxDelta;
+
+        auto slot = (expiry >> (level * slotBits)) & slotMask;
+
+        slots[level][slot].push_back(std::move(entry));
+        bitmaps[level] |= uint64_t(1) << slot;
+    }
+
+    void cascade(int level, uint64_t slot)
+    {
+        if(!(bitmaps[level] & (uint64_t(1) << slot)))
+            return;
+
+        auto entries = std::move(slots[level][slot]);
+        slots[level][slot].clear();
+        bitmaps[level] &= ~(uint64_t(1) << slot);
+
+        // anything expiring now ends up in the current slot of the lowest level
+        for(auto &entry : entries)
+            place(std::move(entry));
+    }
+
+    uint64_t now = 0;
+
+    std::vector<Entry> slots[numLevels][numSlots];
+    uint64_t bitmaps[numLevels]{};
+
+    std::vector<Entry> due;
+    size_t count = 0;
+};
@@ -0,0 +1,155 @@
+#include "TrackGraph.hpp"
+
+#include "ObjectData.hpp"
+#include "World.hpp"
+
+void TrackGraph::build(SlotMap<Object> &objects, const std::vector<ObjectHandle> &movingObjects, unsigned int width, unsigned int height)
+{
+    clear();
+
+    std::vector<bool> moving(objects.getCapacity());
+
+    for(auto &handle : movingObjects)
+    {
+        if(handle.index < moving.size())
+            moving[handle.index] = true;
+    }
+
+    // same as World::getObjectHandleAt, the first created object with occupancy wins
+    std::vector<uint32_t> tileObjects(size_t(width) * height, ~0u);
+
+    for(auto it = objects.begin(); it != objects.end(); ++it)
+    {
+        auto &object = *it;
+        auto objectData = object.getData();
+
+        if(!objectData || moving[it.getHandle().index])
+            continue;
+
+        auto objectX = object.getX();
+        auto objectY = object.getY();
+
+        if(objectX < 0 || objectY < 0 || !objectData->physSizeX)
+            continue;
+
+        unsigned int yAdjust = objectData->bitmapSizeY - objectData->physSizeY;
+
+        for(unsigned int y = 0; y < objectData->physSizeY; y++)
+        {
+            unsigned int tileY = objectY + yAdjust + y;
+
+            if(tileY >= height)
+                break;
+
+            for(unsigned int x = 0; x < objectData->physSizeX; x++)
+            {
+                unsigned int tileX = objectX + x;
+
+                if(tileX >= width)
+                    break;
+
+                auto &tile = tileObjects[tileX + size_t(tileY) * width];
+
+                if(objectData->physicalOccupancy[x + y * objectData->physSizeX]
+                && (tile == ~0u || objects.getAt(tile)->getSerial() > object.getSerial()))
+                    tile = it.getHandle().index;
+            }
+        }
+    }
+
+    nodes.resize(objects.getCapacity());
+
+    // connect the ends of every path
+    for(auto it = objects.begin(); it != objects.end(); ++it)
+    {
+        auto &object = *it;
+        auto objectData = object.getData();
+
+        if(!objectData || objectData->coords.empty() || moving[it.getHandle().index])
+            continue;
+
+        auto handle = it.getHandle();
+        auto &node = nodes[handle.index];
+
+        node.valid = true;
+        node.generation = handle.generation;
+        numNodes++;
+
+        for(int alternate = 0; alternate < 2; alternate++)
+        {
+            auto &coords = alternate ? objectData->altCoords : objectData->coords;
+
+            if(coords.empty())
+                continue;
+
+            for(int end = 0; end < 2; end++)
+            {
+                auto &edge = node.edges[alternate][end];
+                auto finalCoord = end ? coords.back() : coords.front();
+
+                int x = object.getX() * World::tileSize + std::get<0>(finalCoord);
+                int y = object.getY() * World::tileSize + std::get<1>(finalCoord);
+
+                if(x < 0 || y < 0 || unsigned(x / World::tileSize) >= width || unsigned(y / World::tileSize) >= height)
+                    continue;
+
+                auto newIndex = tileObjects[x / World::tileSize + size_t(y / World::tileSize) * width];
+
+                if(newIndex == ~0u || newIndex == handle.index)
+                    continue;
+
+                auto newObj = objects.getAt(newIndex);
+                auto newObjData = newObj->getData();
+
+                if(!newObjData || newObjData->coords.empty())
+                    continue;
+
+                // relative to the new object
+                x -= newObj->getX() * World::tileSize;
+                y -= newObj->getY() * World::tileSize;
+
+                auto coord = std::make_tuple(x, y);
+
+                // coords overlap so the last coord in the prev object is the second in the new one
+                auto &newCoords = newObjData->coords;
+                auto &newAltCoords = newObjData->altCoords;
+
+                edge.connected = true;
+                edge.object = {newIndex, objects.getSlotState(newIndex).generation};
+
+                edge.matchesCoords = newCoords[1] == coord || newCoords[newCoords.size() - 2] == coord;
+                edge.reverse[0] = newCoords[newCoords.size() - 2] == coord;
+
+                if(!newAltCoords.empty())
+                {
+                    edge.matchesAltCoords = newAltCoords[1] == coord || newAltCoords[newAltCoords.size() - 2] == coord;
+                    edge.reverse[1] = newAltCoords[newAltCoords.size() - 2] == coord;
+                }
+            }
+        }
+    }
+}
+
+void TrackGraph::clear()
+{
+    nodes.clear();
+    numNodes = 0;
+}
+
+const TrackGraph::Edge *TrackGraph::getEdge(ObjectHandle object, bool alternate, bool end) const
+{
+    if(object.index >= nodes.size())
+        return nullptr;
+
+    auto &node = nodes[object.index];
+
+    if(!node.valid || node.generation != object.generation)
+        return nullptr;
+
+    return &node.edges[alternate][end];
+}
+
+size_t TrackGraph::getNumNodes() const
+{
+    return numNodes;
+}
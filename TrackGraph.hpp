@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Object.hpp"
+#include "SlotMap.hpp"
+
+// connections between track pieces, so that trains don't have to search for the next one
+// nodes are objects with coords, each end of each path has an edge
+class TrackGraph final
+{
+public:
+    using ObjectHandle = SlotMap<Object>::Handle;
+
+    // where leaving one end of a path goes
+    struct Edge
+    {
+        bool connected = false;
+        ObjectHandle object;
+
+        // which paths of the next object continue from here (both for some points)
+        bool matchesCoords = false, matchesAltCoords = false;
+
+        // entering [coords, altCoords] from their far end
+        bool reverse[2]{};
+    };
+
+    // objects that are moving are skipped (they won't stay)
+    void build(SlotMap<Object> &objects, const std::vector<ObjectHandle> &movingObjects, unsigned int width, unsigned int height);
+    void clear();
+
+    // end is true for the last coord, null if the object isn't track
+    const Edge *getEdge(ObjectHandle object, bool alternate, bool end) const;
+
+    size_t getNumNodes() const;
+
+private:
+    struct Node
+    {
+        bool valid = false;
+        uint32_t generation = 0;
+
+        Edge edges[2][2]; // [alternate][end]
+    };
+
+    std::vector<Node> nodes; // by slot index
+    size_t numNodes = 0;
+};
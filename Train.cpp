@@ -1,4 +1,6 @@
 #include <algorithm>
+#include <array>
+#include <cmath>
 
 #include "Train.hpp"
 
@@ -7,6 +9,38 @@
 static const int rearWheelDist = 22;
 static const int nextCarriageDist = 38;
 
+// angle of (dx, dy) from the y axis in 1/64ths of pi, without atan2
+static int getDirectionFrame(float dx, float dy)
+{
+    // tan of the points halfway between frames, for the first eighth
+    static const auto thresholds = []()
+    {
+        std::array<float, 16> ret;
+
+        for(int i = 0; i < 16; i++)
+            ret[i] = std::tan((i + 0.5f) * float(M_PI) / 64.0f);
+
+        return ret;
+    }();
+
+    float absX = std::abs(dx);
+    float absY = std::abs(dy);
+
+    bool nearY = absX <= absY;
+    float ratio = nearY ? (absY > 0.0f ? absX / absY : 0.0f) : absY / absX;
+
+    int frame = std::upper_bound(thresholds.begin(), thresholds.end(), ratio) - thresholds.begin();
+
+    // unfold to the full circle
+    if(!nearY)
+        frame = 32 - frame;
+
+    if(dy < 0.0f)
+        frame = 64 - frame;
+
+    return dx < 0.0f ? -frame : frame;
+}
+
 Train::Train(World &world, uint16_t engineId, std::string name) : world(world), engine(*this, std::move(world.createObject(engineId, 0, 0, name)))
 {
     speed = 35; // TODO: min/max speed from .dat
@@ -15,6 +49,7 @@ Train::Train(World &world, uint16_t engineId, std::string name) : world(world),
 Train::Train(Train &&other) : world(other.world), engine(*this, std::move(other.engine.getObject()))
 {
     speed = other.speed;
+    std::copy(other.partTypes, other.partTypes + 4, partTypes);
     
     for(auto &carriage : other.carriages)
     {
@@ -23,9 +58,40 @@ Train::Train(Train &&other) : world(other.world), engine(*this, std::move(other.
     }
 
     engine.copyPosition(other.engine);
+
+    pathHistory = std::move(other.pathHistory);
+    pathHistoryStart = other.pathHistoryStart;
+    pathHistorySize = other.pathHistorySize;
 }
 
-void Train::update(uint32_t deltaMs, SoundMixer &sound)
+void Train::beginTick()
+{
+    engine.getObject().beginTick();
+
+    for(auto &carriage : carriages)
+        carriage.getObject().beginTick();
+}
+
+bool Train::update(uint32_t deltaMs, SoundMixer &sound)
+{
+    updateParts(deltaMs, sound);
+
+    // track if anything visible changed
+    bool changed = engine.takeChanged();
+
+    for(auto &carriage : carriages)
+        changed = carriage.takeChanged() || changed;
+
+    // can't have moved
+    if(!deltaMs)
+        return false;
+
+    moving = changed;
+
+    return moving;
+}
+
+void Train::updateParts(uint32_t deltaMs, SoundMixer &sound)
 {
     // drive train from first part that hasn't already left the world
     // (tunnels)
@@ -41,7 +107,7 @@ void Train::update(uint32_t deltaMs, SoundMixer &sound)
         {
             // fully in tunnel, re-appear in another tunnel
             // as we're in a tunnel, one should exist...
-            placeInObject(*world.getTunnels(true)[0]);
+            placeInObject(world.getTunnels(true)[0]);
         }
         return;
     }
@@ -49,31 +115,38 @@ void Train::update(uint32_t deltaMs, SoundMixer &sound)
     // pull remaining carriages
     for(; it != carriages.end(); ++it)
     {
-        if(!it->update(deltaMs, *part, sound))
-            break;
-
+        it->update(deltaMs, *part, sound);
         part = &(*it);
     }
+
+    // the rear wheels of the last part are the furthest back we need
+    auto &lastPart = carriages.empty() ? engine : carriages.back();
+    trimPathHistory(lastPart.getDistance() - rearWheelDist);
 }
 
-void Train::render(SDL_Renderer *renderer, int scrollX, int scrollY, float zoom)
+void Train::getSprites(std::vector<RenderSnapshot::Sprite> &sprites)
 {
-    std::vector<Part *> parts;
-    parts.reserve(carriages.size() + 1);
+    auto first = sprites.size();
 
-    parts.push_back(&engine);
+    sprites.push_back(engine.getObject().getSprite());
 
     for(auto &carriage : carriages)
     {
         if(carriage.getValidPos())
-            parts.push_back(&carriage);
+            sprites.push_back(carriage.getObject().getSprite());
     }
 
     // z-order-ish
-    std::sort(parts.begin(), parts.end(), [](auto &a, auto &b){return a->getObject().getPixelY() < b->getObject().getPixelY();});
+    std::sort(sprites.begin() + first, sprites.end(), [](auto &a, auto &b){return a.pixelY < b.pixelY;});
+}
+
+// time until the train moves a pixel
+uint32_t Train::getNextUpdateDelay() const
+{
+    if(!moving || !speed)
+        return ~0u;
 
-    for(auto &part : parts)
-        part->getObject().render(renderer, scrollX, scrollY, 6, zoom);
+    return std::max(1, 1000 / speed);
 }
 
 void Train::addCarriage(uint16_t id)
@@ -81,40 +154,222 @@ void Train::addCarriage(uint16_t id)
     carriages.emplace_back(*this, std::move(world.createObject(id, 0, 0, "")));
 }
 
-void Train::placeInObject(Object &obj)
+const std::string &Train::getName() const
+{
+    return engine.getObject().getName();
+}
+
+std::vector<uint16_t> Train::getPartIds() const
+{
+    std::vector<uint16_t> ids;
+    ids.reserve(carriages.size() + 1);
+
+    ids.push_back(engine.getObject().getId());
+
+    for(auto &carriage : carriages)
+        ids.push_back(carriage.getObject().getId());
+
+    return ids;
+}
+
+void Train::setPartTypes(const uint32_t types[4])
+{
+    std::copy(types, types + 4, partTypes);
+}
+
+const uint32_t *Train::getPartTypes() const
+{
+    return partTypes;
+}
+
+void Train::saveState(StateWriter &writer) const
 {
-    engine.placeInObject(obj);
+    writer.write(speed);
+    writer.write(moving);
+    writer.write(uint32_t(carriages.size()));
+
+    engine.saveState(writer);
 
     for(auto &carriage : carriages)
-        carriage.placeInObject(obj);
+        carriage.saveState(writer);
+
+    writer.write(uint32_t(pathHistorySize));
 
-    enterObject(engine, obj);
+    for(size_t i = 0; i < pathHistorySize; i++)
+    {
+        auto &point = getPathPoint(i);
+        writer.write(point.distance);
+        writer.write(point.coord.reverse);
+        writer.write(point.coord.alternate);
+        writer.write(point.coord.object);
+    }
 }
 
-void Train::enterObject(Part &part, Object &obj)
+bool Train::restoreState(StateReader &reader)
+{
+    uint32_t numCarriages;
+
+    if(!reader.read(speed) || !reader.read(moving) || !reader.read(numCarriages) || numCarriages != carriages.size())
+        return false;
+
+    if(!engine.restoreState(reader))
+        return false;
+
+    for(auto &carriage : carriages)
+    {
+        if(!carriage.restoreState(reader))
+            return false;
+    }
+
+    uint32_t historySize;
+
+    if(!reader.read(historySize))
+        return false;
+
+    clearPathHistory();
+
+    for(uint32_t i = 0; i < historySize; i++)
+    {
+        PathPoint point;
+
+        if(!reader.read(point.distance) || !reader.read(point.coord.reverse) || !reader.read(point.coord.alternate) || !reader.read(point.coord.object))
+            return false;
+
+        addPathPoint(point.distance, point.coord);
+    }
+
+    return true;
+}
+
+void Train::placeInObject(ObjectHandle handle)
+{
+    auto obj = world.getObject(handle);
+
+    if(!obj)
+        return;
+
+    // start again from here
+    clearPathHistory();
+
+    engine.placeInObject(handle, *obj, 0.0f);
+    addPathPoint(0.0f, engine.getCoord());
+
+    // the rest of the train is behind the engine
+    float distance = 0.0f;
+
+    for(auto &carriage : carriages)
+    {
+        distance -= nextCarriageDist;
+        carriage.placeInObject(handle, *obj, distance);
+    }
+
+    enterObject(engine, handle);
+}
+
+void Train::enterObject(Part &part, ObjectHandle handle)
 {
     // TODO: other end if reversing
     bool isFirst = &part == &engine;
 
+    auto obj = world.getObject(handle);
+
     // close crossing on train entering
     // TODO: should do before train reaches
     // TODO: make sure there are no minifigs
-    if(isFirst && obj.getData()->specialType == ObjectData::SpecialType::LevelCrossing)
+    if(isFirst && obj && obj->getData()->specialType == ObjectData::SpecialType::LevelCrossing)
     {
         // animation name is inconsistent
-        if(!obj.setAnimation("closed"))
-            obj.setAnimation("default");
+        if(!world.setObjectAnimation(handle, "closed"))
+            world.setObjectAnimation(handle, "default");
     }
 }
 
-void Train::leaveObject(Part &part, Object &obj)
+void Train::leaveObject(Part &part, ObjectHandle handle)
 {
     bool isLast = carriages.empty() || &part == &carriages.back();
 
+    auto obj = world.getObject(handle);
+
     // re-open crossing after train leaves
     // TODO: delay?
-    if(isLast && obj.getData()->specialType == ObjectData::SpecialType::LevelCrossing)
-        obj.setAnimation("open");
+    if(isLast && obj && obj->getData()->specialType == ObjectData::SpecialType::LevelCrossing)
+        world.setObjectAnimation(handle, "open");
+}
+
+void Train::clearPathHistory()
+{
+    pathHistoryStart = pathHistorySize = 0;
+}
+
+void Train::addPathPoint(float distance, const CoordMeta &coord)
+{
+    // a part behind the front is driving (the front has left the world), replace what was ahead of it
+    while(pathHistorySize && getPathPoint(pathHistorySize - 1).distance >= distance)
+        pathHistorySize--;
+
+    if(pathHistorySize == pathHistory.size())
+    {
+        // full, unwrap into a bigger buffer
+        std::vector<PathPoint> newHistory(std::max(size_t(16), pathHistory.size() * 2));
+
+        for(size_t i = 0; i < pathHistorySize; i++)
+            newHistory[i] = getPathPoint(i);
+
+        pathHistory = std::move(newHistory);
+        pathHistoryStart = 0;
+    }
+
+    pathHistory[(pathHistoryStart + pathHistorySize) & (pathHistory.size() - 1)] = {distance, coord};
+    pathHistorySize++;
+}
+
+const Train::PathPoint &Train::getPathPoint(size_t index) const
+{
+    return pathHistory[(pathHistoryStart + index) & (pathHistory.size() - 1)];
+}
+
+bool Train::getPathPos(float distance, CoordMeta &coord, float &pathPos) const
+{
+    if(!pathHistorySize)
+        return false;
+
+    // find the last point before distance
+    size_t lo = 0, hi = pathHistorySize;
+
+    while(hi - lo > 1)
+    {
+        auto mid = (lo + hi) / 2;
+
+        if(getPathPoint(mid).distance <= distance)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    auto &point = getPathPoint(lo);
+    coord = point.coord;
+
+    auto obj = world.getObject(coord.object);
+    auto objData = obj ? obj->getData() : nullptr;
+
+    if(!objData)
+        return false;
+
+    auto &path = objData->getTrackPath(coord.alternate);
+    float travelled = distance - point.distance;
+
+    pathPos = coord.reverse ? path.length - travelled : travelled;
+
+    return travelled >= 0.0f;
+}
+
+void Train::trimPathHistory(float distance)
+{
+    while(pathHistorySize > 1 && getPathPoint(1).distance <= distance)
+    {
+        pathHistoryStart = (pathHistoryStart + 1) & (pathHistory.size() - 1);
+        pathHistorySize--;
+    }
 }
 
 Train::Part::Part(Train &parent, Object &&object) : parent(parent), object(std::move(object))
@@ -126,11 +381,11 @@ bool Train::Part::update(uint32_t deltaMs, int speed, SoundMixer &sound)
     object.update(deltaMs, sound);
 
     // find the object we're currently on
-    auto obj = parent.world.getObjectAt(curObjectCoord.x, curObjectCoord.y);
+    auto obj = parent.world.getObject(curObjectCoord.object);
 
     if(!obj)
     {
-        validPos = false;
+        setInvalid();
         return false; // uh oh
     }
 
@@ -138,40 +393,44 @@ bool Train::Part::update(uint32_t deltaMs, int speed, SoundMixer &sound)
 
     if(!objData || objData->coords.empty())
     {
-        validPos = false;
+        setInvalid();
         return false; // how did we get here?
     }
 
     // advance
     int dir = curObjectCoord.reverse ? -1 : 1;
+    float moved = (deltaMs / 1000.0f) * speed;
 
-    objectCoordPos += (deltaMs / 1000.0f) * speed * dir;
+    pathPos += moved * dir;
+    distance += moved;
 
-    int coordIndex = std::floor(objectCoordPos);
+    auto path = &objData->getTrackPath(curObjectCoord.alternate);
 
-    size_t coordsSize = (curObjectCoord.alternate ? objData->altCoords : objData->coords).size();
+    // distance through the object in the direction we're moving
+    auto getTravelled = [this](const ObjectData::TrackPath &path)
+    {
+        return curObjectCoord.reverse ? path.length - pathPos : pathPos;
+    };
 
-    while(coordIndex < 0 || coordIndex >= static_cast<int>(coordsSize - 1))
+    while(getTravelled(*path) >= path->length)
     {
         // moving to next object
         if(enterNextObject(obj, objData))
         {
-            coordIndex = std::floor(objectCoordPos);
-            coordsSize = (curObjectCoord.alternate ? objData->altCoords : objData->coords).size();
+            path = &objData->getTrackPath(curObjectCoord.alternate);
+            parent.addPathPoint(distance - getTravelled(*path), curObjectCoord);
         }
         else if(objData->specialType == ObjectData::SpecialType::Tunnel)
         {
             // reached the end of a tunnel, keep going until offscreen
-            int coordOut = coordIndex < 0 ? -coordIndex : coordIndex - (coordsSize - 2);
-
-            if(coordOut > rearWheelDist)
+            if(getTravelled(*path) - path->length > rearWheelDist)
             {
                 offscreen = true;
                 return false;
             }
 
-            // clamp coord so we extrapolate later
-            coordIndex = coordIndex < 0 ? 0 : coordsSize - 2;
+            // position is extrapolated past the end
+            break;
         }
         else if(objData->specialType == ObjectData::SpecialType::Depot)
         {
@@ -180,49 +439,36 @@ bool Train::Part::update(uint32_t deltaMs, int speed, SoundMixer &sound)
             return false;
         }
         else
+        {
+            // end of the track, stop at the end
+            float over = getTravelled(*path) - path->length;
+            pathPos -= over * dir;
+            distance -= over;
             return false;
+        }
     }
 
-    // get coords again as object might have changed
-    auto &finalCoords = curObjectCoord.alternate ? objData->altCoords : objData->coords;
-    float frac = objectCoordPos - coordIndex;
-
-    int px0, py0, px1, py1;
-    getWorldCoord(finalCoords[coordIndex], px0, py0, *obj);
-    getWorldCoord(finalCoords[coordIndex + 1], px1, py1, *obj);
-
-    float newX = px0 + (px1 - px0) * frac;
-    float newY = py0 + (py1 - py0) * frac;
-
-    setPosition(obj, objData, newX, newY);
+    setPosition(*obj, objData);
     return validPos;
 }
 
-bool Train::Part::update(uint32_t deltaMs, Part &prevPart, SoundMixer &sound)
+bool Train::Part::update(uint32_t deltaMs, const Part &prevPart, SoundMixer &sound)
 {
     object.update(deltaMs, sound);
 
-    // get position from prev part
-    int coordIndex;
-    auto pos = prevPart.getNextCarriagePos(coordIndex, objectCoordPos);
-
-    float newX = std::get<0>(pos);
-    float newY = std::get<1>(pos);
-
-    auto newCoordMeta = prevPart.getCoordMeta(coordIndex);
+    // follow the path of the part in front
+    distance = prevPart.distance - nextCarriageDist;
 
-    if(!newCoordMeta)
-    {
-        validPos = false;
-        return false;
-    }
+    CoordMeta newCoord;
+    float newPathPos;
+    parent.getPathPos(distance, newCoord, newPathPos);
 
     // find the object we're currently on
-    auto obj = parent.world.getObjectAt(newCoordMeta->x, newCoordMeta->y);
+    auto obj = parent.world.getObject(newCoord.object);
 
     if(!obj)
     {
-        validPos = false;
+        setInvalid();
         return false;
     }
 
@@ -231,91 +477,89 @@ bool Train::Part::update(uint32_t deltaMs, Part &prevPart, SoundMixer &sound)
     if(!objData || objData->coords.empty())
         return false; // how did we get here?
 
-    if(newCoordMeta->x != curObjectCoord.x || newCoordMeta->y != curObjectCoord.y)
-    {
-        // copy info for looking behind later
-        for(int i = 2; i > 0; i--)
-            prevObjectCoord[i] = prevObjectCoord[i - 1];
+    if(newCoord.object != curObjectCoord.object)
+        parent.enterObject(*this, newCoord.object);
 
-        prevObjectCoord[0] = curObjectCoord;
+    curObjectCoord = newCoord;
+    pathPos = newPathPos;
 
-        parent.enterObject(*this, *obj);
-
-        // set new obj
-        curObjectCoord = *newCoordMeta;
-    }
-
-    setPosition(obj, objData, newX, newY);
+    setPosition(*obj, objData);
     return validPos;
 }
 
-void Train::Part::placeInObject(Object &inObj)
+void Train::Part::placeInObject(ObjectHandle handle, Object &inObj, float distance)
 {
     auto data = inObj.getData();
 
     if(!data || data->coords.empty())
         return;
 
-    auto coord = data->coords[0];
-
-    int px, py;
-    getWorldCoord(coord, px, py, inObj);
-    object.setPixelPos(px, py);
-
-    objectCoordPos = 0.0f;
+    pathPos = 0.0f;
     curObjectCoord.reverse = false;
     curObjectCoord.alternate = false;
-    curObjectCoord.x = inObj.getX();
-    curObjectCoord.y = inObj.getY() + data->bitmapSizeY - data->physSizeY;
+    curObjectCoord.object = handle;
 
     // flip direction so that we're always exiting a depot/tunnel
     if((data->specialType == ObjectData::SpecialType::Depot || data->specialType == ObjectData::SpecialType::Tunnel) &&
        (data->specialSide == ObjectData::SpecialSide::Bottom || data->specialSide == ObjectData::SpecialSide::Left))
     {
         curObjectCoord.reverse = true;
-        objectCoordPos = data->coords.size() - 2;
+        pathPos = data->getTrackPath(false).length;
     }
 
-    // clear prev objects
-    for(int i = 0; i < 3; i++)
-    {
-        prevObjectCoord[i].x = -1;
-        prevObjectCoord[i].y = -1;
-    }
+    float px, py;
+    getWorldPos(data->getTrackPath(false), pathPos, inObj, px, py);
+    object.setPixelPos(px, py);
+
+    this->distance = distance;
+    rearObject = {};
 
     offscreen = false;
     validPos = false; // will update on first update
+    changed = true;
 }
 
-void Train::Part::getWorldCoord(const std::tuple<int, int> &coord, int &x, int &y, const Object &obj)
+void Train::Part::getWorldPos(const ObjectData::TrackPath &path, float pos, const Object &obj, float &x, float &y) const
 {
-    x = obj.getX() * World::tileSize + std::get<0>(coord);
-    y = obj.getY() * World::tileSize + std::get<1>(coord);
+    path.getPos(pos, x, y);
+
+    x += obj.getX() * World::tileSize;
+    y += obj.getY() * World::tileSize;
 }
 
 void Train::Part::copyPosition(const Part &other)
 {
-    objectCoordPos = other.objectCoordPos;
+    pathPos = other.pathPos;
+    distance = other.distance;
     curObjectCoord = other.curObjectCoord;
-
-    for(int i = 0; i < 3; i++)
-        prevObjectCoord[i] = other.prevObjectCoord[i];
+    rearObject = other.rearObject;
 }
 
-std::tuple<float, float> Train::Part::getNextCarriagePos(int &finalCoordIndex, float &finalCoordPos)
+void Train::Part::saveState(StateWriter &writer) const
 {
-    auto obj = parent.world.getObjectAt(curObjectCoord.x, curObjectCoord.y);
+    writer.write(object.getState());
+    writer.write(validPos);
+    writer.write(offscreen);
+    writer.write(pathPos);
+    writer.write(distance);
+
+    // written separately to avoid padding
+    writer.write(curObjectCoord.reverse);
+    writer.write(curObjectCoord.alternate);
+    writer.write(curObjectCoord.object);
+    writer.write(rearObject);
+}
 
-    if(!obj)
-        return {0.0f, 0.0f}; // uh oh
+bool Train::Part::restoreState(StateReader &reader)
+{
+    Object::State objectState;
 
-    auto objData = obj->getData();
+    if(!reader.read(objectState) || !reader.read(validPos) || !reader.read(offscreen) || !reader.read(pathPos) || !reader.read(distance))
+        return false;
 
-    if(!objData || objData->coords.empty())
-        return {0.0f, 0.0f};
+    object.setState(objectState);
 
-    int lastUsed;
-    return lookBehind(nextCarriageDist, obj, objData, lastUsed, finalCoordIndex, finalCoordPos);
+    return reader.read(curObjectCoord.reverse) && reader.read(curObjectCoord.alternate) && reader.read(curObjectCoord.object) && reader.read(rearObject);
 }
 
 Object &Train::Part::getObject()
@@ -323,6 +567,11 @@ Object &Train::Part::getObject()
     return object;
 }
 
+const Object &Train::Part::getObject() const
+{
+    return object;
+}
+
 bool Train::Part::getValidPos() const
 {
     return validPos;
@@ -333,12 +582,29 @@ bool Train::Part::getOffscreen() const
     return offscreen;
 }
 
+float Train::Part::getDistance() const
+{
+    return distance;
+}
+
+bool Train::Part::takeChanged()
+{
+    bool ret = changed;
+    changed = false;
+    return ret;
+}
+
+const Train::CoordMeta &Train::Part::getCoord() const
+{
+    return curObjectCoord;
+}
+
 bool Train::Part::isInTunnel() const
 {
     if(!offscreen)
         return false;
     
-    auto obj = parent.world.getObjectAt(curObjectCoord.x, curObjectCoord.y);
+    auto obj = parent.world.getObject(curObjectCoord.object);
 
     if(!obj)
         return false;
@@ -349,37 +615,37 @@ bool Train::Part::isInTunnel() const
 }
 
 // helper to position and orientation
-void Train::Part::setPosition(Object *obj, const ObjectData *objData, float newX, float newY)
+void Train::Part::setPosition(const Object &obj, const ObjectData *objData)
 {
-    // use the coord for the front of the train
-    // try to find the back
-    int lastUsedObj;
-    int rearCoordIndex;
-    float rearCoordPos;
-    auto rearCoord = lookBehind(rearWheelDist, obj, objData, lastUsedObj, rearCoordIndex, rearCoordPos);
+    float newX, newY;
+    getWorldPos(objData->getTrackPath(curObjectCoord.alternate), pathPos, obj, newX, newY);
+
+    // find the rear wheels in the history
+    CoordMeta rearCoord;
+    float rearPathPos;
+    bool rearFound = parent.getPathPos(distance - rearWheelDist, rearCoord, rearPathPos);
+
+    auto rearObj = parent.world.getObject(rearCoord.object);
+    auto rearObjData = rearObj ? rearObj->getData() : nullptr;
+
+    float rearX = newX, rearY = newY;
+
+    if(rearObjData)
+        getWorldPos(rearObjData->getTrackPath(rearCoord.alternate), rearPathPos, *rearObj, rearX, rearY);
 
     // leave objects
-    for(int i = 2; i > lastUsedObj; i--)
+    if(rearCoord.object != rearObject)
     {
-        if(prevObjectCoord[i].x != -1)
-        {
-            auto prevObj = parent.world.getObjectAt(prevObjectCoord[i].x, prevObjectCoord[i].y);
-            if(prevObj)
-                parent.leaveObject(*this, *prevObj);
-
-            prevObjectCoord[i].x = prevObjectCoord[i].y = -1;
-        }
+        parent.leaveObject(*this, rearObject);
+        rearObject = rearCoord.object;
     }
 
-    float rearX = std::get<0>(rearCoord);
-    float rearY = std::get<1>(rearCoord);
-
     // orient train
-    float angle = std::atan2(rearX - newX, rearY - newY);
-    int frame = std::round(angle * 64.0f / M_PI);
-    
+    int frame = getDirectionFrame(rearX - newX, rearY - newY);
+
     frame = (frame + 96) % 128;
 
+    int oldFrame = object.getAnimationFrame();
     object.setAnimationFrame(frame);
 
     // adjust pos using the train data
@@ -394,49 +660,41 @@ void Train::Part::setPosition(Object *obj, const ObjectData *objData, float newX
         newY = newY + engineData->hotspotY - std::get<1>(trainData[frame]);
     }
 
+    if(newX != object.getPixelX() || newY != object.getPixelY() || object.getAnimationFrame() != oldFrame || validPos != rearFound)
+        changed = true;
+
     object.setPixelPos(newX, newY);
 
-    validPos = rearCoordIndex != -1 || std::abs(rearCoordPos - objectCoordPos) >= (rearWheelDist - 1);
+    validPos = rearFound;
 }
 
+void Train::Part::setInvalid()
+{
+    if(validPos)
+        changed = true;
+
+    validPos = false;
+}
 bool Train::Part::enterNextObject(Object *&obj, const ObjectData *&objData)
 {
-    auto &coords = curObjectCoord.alternate ? objData->altCoords : objData->coords;
+    auto &path = objData->getTrackPath(curObjectCoord.alternate);
 
-    auto finalCoord = curObjectCoord.reverse ? coords.front() : coords.back();
+    // where the end we're at leads
+    auto edge = parent.world.getTrackGraph().getEdge(curObjectCoord.object, curObjectCoord.alternate, !curObjectCoord.reverse);
 
-    int x, y;
-    getWorldCoord(finalCoord, x, y, *obj);
+    if(!edge || !edge->connected)
+        return false;
 
-    auto newObj = parent.world.getObjectAt(x / World::tileSize, y / World::tileSize);
+    auto newObj = parent.world.getObject(edge->object);
 
-    if(!newObj || newObj == obj)
+    if(!newObj)
         return false;
 
-    // make coord relative to new object
-    x -= newObj->getX() * World::tileSize;
-    y -= newObj->getY() * World::tileSize;
-
     auto newObjData = newObj->getData();
 
-    if(!newObjData || newObjData->coords.empty())
-        return false; // not again...
-
-    // copy info for looking behind later
-    for(int i = 2; i > 0; i--)
-        prevObjectCoord[i] = prevObjectCoord[i - 1];
-
-    prevObjectCoord[0] = curObjectCoord;
-
-    // figure out which coord path we're on, and at which end
-    // coords overlap so the last coord in the prev object is the second in the new one
-    bool hasAlt = !newObjData->altCoords.empty();
-
-    bool matchesCoords = newObjData->coords[1] == std::make_tuple(x, y) || newObjData->coords[newObjData->coords.size() - 2] == std::make_tuple(x, y);
-    bool matchesAltCoords = false;
-
-    if(hasAlt)
-        matchesAltCoords = newObjData->altCoords[1] == std::make_tuple(x, y) || newObjData->altCoords[newObjData->altCoords.size() - 2] == std::make_tuple(x, y);
+    // which coord path we're on, and at which end
+    bool matchesCoords = edge->matchesCoords;
+    bool matchesAltCoords = edge->matchesAltCoords;
 
     if(newObjData->specialType == ObjectData::SpecialType::Points)
     {
@@ -455,146 +713,31 @@ bool Train::Part::enterNextObject(Object *&obj, const ObjectData *&objData)
         {
             // may need to switch
             if(open != matchesAltCoords)
-                newObj->setAnimation(open ? "closed" : "open");
+                parent.world.setObjectAnimation(edge->object, open ? "closed" : "open");
         }
     }
 
     curObjectCoord.alternate = matchesAltCoords;
 
-    auto &newCoords = curObjectCoord.alternate ? newObjData->altCoords : newObjData->coords;
+    auto &newPath = newObjData->getTrackPath(curObjectCoord.alternate);
 
-    bool newRev = newCoords[newCoords.size() - 2] == std::make_tuple(x, y);
+    bool newRev = edge->reverse[curObjectCoord.alternate];
 
-    if(!curObjectCoord.reverse && !newRev)
-        objectCoordPos -= (coords.size() - 2);
-    else if(curObjectCoord.reverse && !newRev) // backwards -> forwards
-        objectCoordPos = objectCoordPos * -1.0f + 1.0f;
-    else if(!curObjectCoord.reverse) // forwards -> backwards
-    {
-        objectCoordPos -= (coords.size() - 1);
-        objectCoordPos = (newCoords.size() - 2) - objectCoordPos;
-    }
-    else // backwards -> backwards
-        objectCoordPos = (newCoords.size() - 2) + objectCoordPos;
+    // the last segment of the old path is the first of the new one
+    float travelled = (curObjectCoord.reverse ? path.length - pathPos : pathPos) - path.length + newPath.getFirstSegmentLength(newRev);
+
+    pathPos = newRev ? newPath.length - travelled : travelled;
 
     curObjectCoord.reverse = newRev;
 
     // enter new object
-    parent.enterObject(*this, *newObj);
+    parent.enterObject(*this, edge->object);
 
     // use new object
     obj = newObj;
     objData = newObjData;
 
-    // add offset to make sure we point to a tile that has occupancy
-    curObjectCoord.x = obj->getX() + x / World::tileSize;
-    curObjectCoord.y = obj->getY() + y / World::tileSize;
+    curObjectCoord.object = edge->object;
 
     return true;
 }
-
-Train::Part::CoordMeta *Train::Part::getCoordMeta(int index)
-{
-    if(index == -1)
-        return &curObjectCoord;
-
-    if(index < 3)
-        return &prevObjectCoord[index];
-
-    // out of bounds
-    return nullptr;
-}
-
-std::tuple<float, float> Train::Part::lookBehind(int dist, const Object *obj, const ObjectData *objData, int &lastUsedObj, int &finalObjectIndex, float &finalCoordPos)
-{
-    auto &finalCoords = curObjectCoord.alternate ? objData->altCoords : objData->coords;
-
-    int coordIndex = std::floor(objectCoordPos);
-    float frac = objectCoordPos - coordIndex;
-
-    int rearCoordIndex = coordIndex + (curObjectCoord.reverse ? dist : -dist);
-
-    std::tuple<int, int> rearCoord0, rearCoord1;
-    auto rearObj = obj;
-
-    lastUsedObj = -1;
-    finalObjectIndex = -1;
-
-    if(rearCoordIndex < 0 || rearCoordIndex >= static_cast<int>(finalCoords.size() - 1))
-    {
-        auto rearObjData = objData;
-        int rearCoordMax = finalCoords.size() - 1;
-        bool prevAlt = curObjectCoord.alternate;
-
-        for(int i = 0; i < 3; i++)
-        {
-            if(prevObjectCoord[i].x == -1)
-                break;
-
-            // look back at prev object
-            if(rearCoordIndex > 0)
-                rearCoordIndex = rearCoordIndex - (rearCoordMax - 1);
-            else
-                rearCoordIndex = -rearCoordIndex;
-
-            // this should exist, we were just there
-            rearObj = parent.world.getObjectAt(prevObjectCoord[i].x, prevObjectCoord[i].y);
-            rearObjData = rearObj->getData();
-
-            auto &prevCoords = prevObjectCoord[i].alternate ? rearObjData->altCoords : rearObjData->coords;
-
-            rearCoordIndex = prevObjectCoord[i].reverse ? rearCoordIndex : prevCoords.size() - (rearCoordIndex + 2);
-            rearCoordMax = prevCoords.size() - 1;
-            prevAlt = prevObjectCoord[i].alternate;
-
-            if(rearCoordIndex >= 0 && rearCoordIndex < rearCoordMax)
-            {
-                lastUsedObj = finalObjectIndex = i;
-
-                // keep a buffer for calculating next car pos
-                int remainingCoords = prevObjectCoord[i].reverse ? rearCoordMax - rearCoordIndex : rearCoordIndex;
-
-                if(remainingCoords <= (nextCarriageDist - rearWheelDist))
-                    lastUsedObj++;
-
-                rearCoord0 = prevCoords[rearCoordIndex];
-                rearCoord1 = prevCoords[rearCoordIndex + 1];
-                break;
-            }
-        }
-
-        if(rearObj == obj || rearCoordIndex < 0 || rearCoordIndex >= rearCoordMax)
-        {
-            // still failed, clamp
-            auto &prevCoords = prevAlt ? rearObjData->altCoords : rearObjData->coords;
-
-            rearCoordIndex = rearCoordIndex < 0 ? 0 : rearCoordMax - 1;
-            rearCoord0 = prevCoords[rearCoordIndex];
-            rearCoord1 = prevCoords[rearCoordIndex + 1];
-        }
-    }
-    else
-    {
-        // rear of train is in same object
-        rearCoord0 = finalCoords[rearCoordIndex];
-        rearCoord1 = finalCoords[rearCoordIndex + 1];
-
-        // keep buffer
-        int remainingCoords = curObjectCoord.reverse ? finalCoords.size() - 1 - rearCoordIndex : rearCoordIndex;
-
-        if(remainingCoords <= (nextCarriageDist - rearWheelDist))
-            lastUsedObj++;
-    }
-
-    int px0, py0, px1, py1;
-
-    getWorldCoord(rearCoord0, px0, py0, *rearObj);
-    getWorldCoord(rearCoord1, px1, py1, *rearObj);
-
-    float rearX = px0 + (px1 - px0) * frac;
-    float rearY = py0 + (py1 - py0) * frac;
-
-    finalCoordPos = rearCoordIndex + frac;
-
-    return {rearX, rearY};
-}
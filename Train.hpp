@@ -1,83 +1,137 @@
 #pragma once
 
 #include "Object.hpp"
+#include "SlotMap.hpp"
+#include "StateBuffer.hpp"
 
 class World;
 
 class Train final
 {
 public:
+    using ObjectHandle = SlotMap<Object>::Handle;
+
     Train(World &world, uint16_t engineId, std::string name);
     Train(Train &) = delete;
     Train(Train &&other);
 
-    void update(uint32_t deltaMs, SoundMixer &sound);
+    // remembers part positions for interpolating
+    void beginTick();
+
+    bool update(uint32_t deltaMs, SoundMixer &sound);
 
-    void render(SDL_Renderer *renderer, int scrollX, int scrollY, float zoom);
+    // adds the visible parts
+    void getSprites(std::vector<RenderSnapshot::Sprite> &sprites);
 
     void addCarriage(uint16_t id);
 
-    void placeInObject(Object &obj);
+    // for saving
+    const std::string &getName() const;
+    std::vector<uint16_t> getPartIds() const; // engine first
+
+    // unknown values stored with each part in saves, kept so they can be written back
+    void setPartTypes(const uint32_t types[4]);
+    const uint32_t *getPartTypes() const;
+
+    void placeInObject(ObjectHandle handle);
+
+    uint32_t getNextUpdateDelay() const;
+
+    // for rewinding, the parts can't change
+    void saveState(StateWriter &writer) const;
+    bool restoreState(StateReader &reader);
 
 private:
+    struct CoordMeta
+    {
+        bool reverse = false; // moving along the coords backwards
+        bool alternate = false; // use the other coords (points)
+        ObjectHandle object;
+    };
 
     struct Part
     {
         Part(Train &parent, Object &&object);
 
         bool update(uint32_t deltaMs, int speed, SoundMixer &sound);
-        bool update(uint32_t deltaMs, Part &prevPart, SoundMixer &sound);
+        bool update(uint32_t deltaMs, const Part &prevPart, SoundMixer &sound);
 
-        void placeInObject(Object &obj);
+        void placeInObject(ObjectHandle handle, Object &obj, float distance);
     
-        void getWorldCoord(const std::tuple<int, int> &coord, int &x, int &y, const Object &obj);
+        void getWorldPos(const ObjectData::TrackPath &path, float pos, const Object &obj, float &x, float &y) const;
 
         void copyPosition(const Part &other);
 
-        std::tuple<float, float> getNextCarriagePos(int &finalCoordIndex, float &finalCoordPos);
-
         Object &getObject();
+        const Object &getObject() const;
 
         bool getValidPos() const;
         bool getOffscreen() const;
+        float getDistance() const;
+
+        // if the position, frame or validity changed since the last call
+        bool takeChanged();
+        const CoordMeta &getCoord() const;
 
         bool isInTunnel() const;
 
-    private:
-        struct CoordMeta
-        {
-            bool reverse = false; // moving along the coords backwards
-            bool alternate = false; // use the other coords (points)
-            int x = 0, y = 0;
-        };
+        void saveState(StateWriter &writer) const;
+        bool restoreState(StateReader &reader);
 
-        void setPosition(Object *obj, const ObjectData *objData, float newX, float newY);
+    private:
+        void setPosition(const Object &obj, const ObjectData *objData);
+        void setInvalid();
 
         bool enterNextObject(Object *&obj, const ObjectData *&objData);
 
-        CoordMeta *getCoordMeta(int index);
-
-        std::tuple<float, float> lookBehind(int dist, const Object *obj, const ObjectData *objData, int &lastUsedObj, int &finalObjectIndex, float &finalCoordPos);
-
         Train &parent;
         Object object;
 
         bool validPos = false;
         bool offscreen = false; // technically more like "has left the world"
+        bool changed = false;
 
-        float objectCoordPos = 0.0f;
+        float pathPos = 0.0f; // distance along the object's path in pixels
+        float distance = 0.0f; // along the train's path history
         CoordMeta curObjectCoord;
 
-        CoordMeta prevObjectCoord[3];
+        ObjectHandle rearObject; // where the rear wheels are, for leaving objects
+    };
+
+    // where the train has been, a point each time the front enters an object
+    struct PathPoint
+    {
+        float distance; // at the start of the object's path, in the direction of travel
+        CoordMeta coord;
     };
 
-    void enterObject(Part &part, Object &obj);
-    void leaveObject(Part &part, Object &obj);
+    void updateParts(uint32_t deltaMs, SoundMixer &sound);
+
+    void enterObject(Part &part, ObjectHandle handle);
+    void leaveObject(Part &part, ObjectHandle handle);
+
+    void clearPathHistory();
+    void addPathPoint(float distance, const CoordMeta &coord);
+    const PathPoint &getPathPoint(size_t index) const;
+
+    // false if the distance is before the start of the history (the position is extrapolated)
+    bool getPathPos(float distance, CoordMeta &coord, float &pathPos) const;
+
+    // drops points before distance that aren't needed
+    void trimPathHistory(float distance);
 
     World &world;
     Part engine;
 
     std::vector<Part> carriages;
 
+    // ring buffer, size is a power of two
+    std::vector<PathPoint> pathHistory;
+    size_t pathHistoryStart = 0, pathHistorySize = 0;
+
     int speed;
+
+    uint32_t partTypes[4]{};
+
+    bool moving = true;
 };
\ No newline at end of file
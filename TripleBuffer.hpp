@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// lock-free handoff of the latest value from one producer thread to one consumer thread
+// the producer fills getBack() and publishes it, the consumer picks up the newest one
+// older values that were never picked up are overwritten
+template<class T>
+class TripleBuffer final
+{
+public:
+    // producer
+    T &getBack()
+    {
+        return buffers[back];
+    }
+
+    void publish()
+    {
+        // swap the back buffer with the middle one
+        back = middle.exchange(back | newFlag, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // consumer
+    // returns true if a new value was published since the last call
+    bool update()
+    {
+        if(!(middle.load(std::memory_order_relaxed) & newFlag))
+            return false;
+
+        front = middle.exchange(front, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    const T &getFront() const
+    {
+        return buffers[front];
+    }
+
+private:
+    static const uint8_t indexMask = 3;
+    static const uint8_t newFlag = 4;
+
+    T buffers[3];
+
+    uint8_t back = 0; // only used by the producer
+    std::atomic<uint8_t> middle{1};
+    uint8_t front = 2; // only used by the consumer
+};
@@ -1,18 +1,53 @@
 #include <algorithm>
-#include <cassert>
 #include <charconv>
+#include <cmath>
 #include <cstring>
-#include <fstream>
 #include <iostream>
 
 #include "World.hpp"
 
 #include "IniFile.hpp"
 #include "ObjectData.hpp"
+#include "SaveLoader.hpp"
+#include "SaveWriter.hpp"
+#include "StateBuffer.hpp"
 
-World::World(FileLoader &fileLoader, TextureLoader &texLoader, ObjectDataStore &objectDataStore) :
-    fileLoader(fileLoader), texLoader(texLoader), objectDataStore(objectDataStore), randomGen(std::random_device{}())
+// days between 1970-01-01 and y-m-d (proleptic Gregorian)
+static int64_t daysFromCivil(int y, int m, int d)
 {
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    int yoe = static_cast<int>(y - era * 400);
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+// inverse of daysFromCivil
+static void civilFromDays(int64_t days, int &y, int &m, int &d)
+{
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int doe = static_cast<int>(days - era * 146097);
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<int>(yoe + era * 400) + (m <= 2);
+}
+
+World::World(FileLoader &fileLoader, TextureLoader &texLoader, ObjectDataStore &objectDataStore, uint32_t randomSeed) :
+    fileLoader(fileLoader), texLoader(texLoader), objectDataStore(objectDataStore), randomGen(randomSeed)
+{
+    // start at the real local time
+    auto time = std::time(nullptr);
+    auto tm = std::localtime(&time);
+
+    int64_t days = daysFromCivil(tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday);
+    setDateTime(days * 86400 + tm->tm_hour * 3600 + tm->tm_min * 60 + tm->tm_sec);
+
     loadEasterEggs();
 }
 
@@ -23,216 +58,257 @@ World::~World()
 
 bool World::loadSave(const std::filesystem::path &path)
 {
-    std::ifstream file(path, std::ios::binary);
+    // all in one go
+    SaveLoader loader(*this, path);
 
-    if(!file)
-    {
-        std::cerr << "Failed to open " << path;
-        return false;
-    }
+    while(loader.update(0));
 
-    // initial header
-    uint8_t header[0x114];
+    return loader.getPhase() == SaveLoader::Phase::Done;
+}
 
-    if(file.read(reinterpret_cast<char *>(header), sizeof(header)).gcount() != sizeof(header))
-    {
-        std::cerr << "Failed to read header for " << path << "\n";
-        return false;
-    }
+void World::unload()
+{
+    // trains first, their objects use the object states
+    trains.clear();
 
-    // always the same in every file so far
-    assert(header[0] == 8 && header[1] == 0);
-    assert(header[6] == 0 && header[7] == 0);
+    objects.clear();
+    nextObjectSerial = 0;
+    movingObjects.clear();
 
-    width = header[2] | header[3] << 8;
-    height = header[4] | header[5] << 8;
+    // keep the time events
+    std::vector<TimerWheel<TimerEvent>::Timer> keptTimers;
+    timers.getTimers(keptTimers);
 
-    uint32_t numObjects = header[8] | header[9] << 8 | header[10] << 16 | header[11] << 24;
-    uint16_t numTrains = header[12] | header[13] << 8;
+    keptTimers.erase(std::remove_if(keptTimers.begin(), keptTimers.end(), [](auto &timer){return timer.data.type != TimerEvent::Type::TimeEvent;}), keptTimers.end());
+    timers.restore(timers.getTime(), keptTimers);
 
-    // load backdrop
-    char *backdropName = reinterpret_cast<char *>(header + 14);
+    width = height = 0;
+    scrollX = scrollY = 0;
 
-    backdropPath = "backdrop/";
+    backdropPath.clear();
+    backdrop.reset();
+    eventTextures.clear();
 
-    // build path, default to "backdrop"
-    backdropPath.append(backdropName[0] ? backdropName : "backdrop").append(".bmp");
+    savePath.clear();
 
-    backdrop = texLoader.loadTexture(backdropPath);
+    trackGraph.clear();
+    trackGraphDirty = true;
 
-    // the rest is usually 0
-#ifndef NDEBUG
-    auto ptr = header + 14 + strlen(backdropName);
-    for(; ptr < header + sizeof(ptr); ptr++)
-        assert(*ptr == 0);
-#endif
+    resetChunks();
+    staticSprites.reset();
+    redrawNeeded = true;
+}
 
-    // type of object in each tile?
-    // might be the preview image?
-    // empty tile=0, scenery=2, (non-rail)building=3, track=5, road=6, footpath=7
-    delete[] tileObjectType;
-    tileObjectType = new uint8_t[width * height];
+bool World::reload()
+{
+    // loadSave clears it
+    auto path = savePath;
 
-    if(file.read(reinterpret_cast<char *>(tileObjectType), width * height).gcount() != width * height)
-    {
-        std::cerr << "Failed to read tile type data for " << path << "\n";
-        return false;
-    }
+    return loadSave(path);
+}
 
-    // next is object data
-    objects.clear();
-    objects.reserve(numObjects);
+const std::filesystem::path &World::getSavePath() const
+{
+    return savePath;
+}
 
-    std::vector<size_t> depots;
+// common to both formats, resets everything and allocates the tile types
+void World::beginLoad(const std::filesystem::path &path, uint16_t newWidth, uint16_t newHeight, const char *backdropName)
+{
+    unload();
 
-    for(uint32_t i = 0; i < numObjects; i++)
-    {
-        uint8_t objectData[0x80];
+    savePath = path;
 
-        if(file.read(reinterpret_cast<char *>(objectData), sizeof(objectData)).gcount() != sizeof(objectData))
-        {
-            std::cerr << "Failed to read object " << i << " in " << path << "\n";
-            return false;
-        }
+    width = newWidth;
+    height = newHeight;
 
-        uint16_t objectId = objectData[0] | objectData[1] << 8;
-        uint16_t objectX = objectData[2] | objectData[3] << 8;
-        uint16_t objectY = objectData[4] | objectData[5] << 8;
+    // load backdrop
+    backdropPath = getBackdropPath(backdropName);
+    backdrop = texLoader.loadTexture(backdropPath);
 
-        // 6-7 are probably padding to align the oversized frameset index
+    // reuse the last save's tiles if big enough
+    size_t numTiles = size_t(width) * height;
 
-        int framesetIndex = objectData[8] | objectData[9] << 8 | objectData[10] << 16 | objectData[11] << 24; // this is waaay bigger than it needs to be
+    if(numTiles > tileObjectTypeSize)
+    {
+        delete[] tileObjectType;
+        tileObjectType = new uint8_t[numTiles];
+        tileObjectTypeSize = numTiles;
+    }
 
-        // 4 bytes unknown?
+    resetChunks();
+}
 
-        char *objectName = reinterpret_cast<char *>(objectData + 16);
+void World::addTrain(const uint32_t ids[4], const uint32_t types[4], const char *name, const std::vector<ObjectHandle> &depots, size_t &depotIndex)
+{
+    Train train(*this, ids[0], name);
+    train.setPartTypes(types);
 
-        auto &object = addObject(objectId, objectX, objectY, objectName);
+    // carriages
+    for(int j = 1; j < 4; j++)
+    {
+        if(ids[j])
+            train.addCarriage(ids[j]);
+    }
 
-        object.setAnimation(framesetIndex);
+    // assign to empty depot
+    // TODO: if not enough depots, trains need to leave the depot immediately
+    if(!depots.empty())
+    {
+        train.placeInObject(depots[depotIndex]);
+        depotIndex = (depotIndex + 1) % depots.size();
+    }
 
-        bool hasUnk = false;
+    trains.emplace_back(std::move(train));
+}
 
-        for(int j = 6; j < 16; j++)
-        {
-            if((j < 8 || j >= 12) && objectData[j])
-            {
-                if(!hasUnk)
-                    std::cout << "object " << objectId << " (\"" << objectName << "\") at " << objectX << ", " << objectY << std::hex;
+void World::finishLoad()
+{
+    clampScroll();
 
-                std::cout << " unk" << j << "=" << int(objectData[j]);
-                hasUnk = true;
-            }
-        }
+    applyLoadEasterEggs();
 
-        if(hasUnk)
-            std::cout << std::dec << std::endl;
+    // TODO: this should happen when closing the toybox
+    applyInsertEasterEggs();
 
-        // up to 5 minifigs
-        auto minifigData = objectData + 0x1C;
-        for(int j = 0; j < 5; j++, minifigData += 20)
-        {
-            uint32_t minifigId = minifigData[0] | minifigData[1] << 8 | minifigData[2] << 16 | minifigData[3] << 24;
+    updateTrackGraph();
 
-            // 4 bytes unknown (possibly uninitialised data?)
-            char *minifigName = reinterpret_cast<char *>(minifigData + 8);
+    // objects were added without invalidating, and a snapshot may have been taken while loading
+    resetChunks();
+}
 
-            object.addMinifig(Minifig{minifigId, minifigName});
+void World::update(uint32_t deltaMs, SoundMixer &sound)
+{
+    using Clock = std::chrono::steady_clock;
 
-            if(minifigId)
-            {
-                std::cout << "\tminifig " << minifigId << " \"" << minifigName << "\" (unk " << std::hex
-                          << int(minifigData[4]) << ", " << int(minifigData[5]) << ", "
-                          << int(minifigData[6]) << ", " << int(minifigData[7]) << std::dec << ")\n";
-            }
-        }
+    // adds the time since the last call to one of updateTimes
+    auto lapTime = updateTimesEnabled ? Clock::now() : Clock::time_point{};
 
-        // collect depots for placing trains
-        if(object.getData() && object.getData()->specialType == ObjectData::SpecialType::Depot)
-            depots.push_back(objects.size() - 1);
-    }
+    auto lap = [this, &lapTime](Clock::duration &total)
+    {
+        if(!updateTimesEnabled)
+            return;
+
+        auto now = Clock::now();
+        total += now - lapTime;
+        lapTime = now;
+    };
 
-    // TODO: shuffle depots?
-    size_t depotIndex = 0;
+    dateTimeMs += deltaMs;
 
-    // trains
-    for(uint32_t i = 0; i < numTrains; i++)
+    // nothing else changes position between ticks
+    for(auto &handle : movingObjects)
     {
-        uint8_t trainData[44];
+        if(auto object = objects.get(handle))
+            object->beginTick();
+    }
 
-        if(file.read(reinterpret_cast<char *>(trainData), sizeof(trainData)).gcount() != sizeof(trainData))
-        {
-            std::cerr << "Failed to read train " << i << " in " << path << "\n";
-            return false;
-        }
+    for(auto &train : trains)
+        train.beginTick();
 
-        // first we have the object ids for the engine and carriages
-        auto ids = reinterpret_cast<uint32_t *>(trainData);
-        // then another value related to each
-        // for engine: 1 = not steam, 2 = steam ?
-        // for carriage: 2 = passenger, 3 = cargo, 4 = mail ?
-        auto type = reinterpret_cast<uint32_t *>(trainData + 16);
-        // then a name
-        auto name = reinterpret_cast<char *>(trainData + 32);
+    // only moving objects need updating every time
+    if(!movingObjects.empty())
+        redrawNeeded = true;
 
-        std::cout << "\ttrain " << name;
+    for(size_t i = 0; i < movingObjects.size();)
+    {
+        auto handle = movingObjects[i];
+        auto object = objects.get(handle);
 
-        for(int j = 0; j < 4; j++)
+        if(object)
         {
-            if(ids[j])
-                std::cout << " " << ids[j] << "(" << type[j] << ")";
+            object->updateMotion(deltaMs);
+            object->checkTarget();
         }
 
-        std::cout << std::endl;
+        bool moving = object && object->isMoving();
 
-        Train train(*this, ids[0], name);
-
-        // carriages
-        for(int j = 1; j < 4; j++)
+        // finished moving
+        if(object && object->getId() == 0xFFFF)
         {
-            if(ids[j])
-                train.addCarriage(ids[j]);
+            removeObject(handle);
+            moving = false;
         }
 
-        // assign to empty depot
-        // TODO: if not enough depots, trains need to leave the depot immediately
-        if(!depots.empty())
+        if(moving)
+            i++;
+        else
         {
-            train.placeInObject(objects[depots[depotIndex]]);
-            depotIndex = (depotIndex + 1) % depots.size();
+            movingObjects[i] = movingObjects.back();
+            movingObjects.pop_back();
         }
+    }
 
-        trains.emplace_back(std::move(train));
+    lap(updateTimes.motion);
+
+    // everything else happens when a timer fires
+    firedTimers.clear();
+    timers.advance(deltaMs, firedTimers);
+
+    lap(updateTimes.timers);
+
+    animationTimers.clear();
+
+    for(auto &timer : firedTimers)
+    {
+        if(timer.data.type == TimerEvent::Type::Animation)
+            animationTimers.push_back(&timer);
     }
 
-    clampScroll();
+    // step animations in parallel, in fixed size chunks with their own commands
+    // applying the chunks in order gives the same result however many threads there are
+    unsigned int numChunks = (animationTimers.size() + updateChunkSize - 1) / updateChunkSize;
 
-    applyLoadEasterEggs();
+    if(updateCommands.size() < numChunks)
+        updateCommands.resize(numChunks);
 
-    // TODO: this should happen when closing the toybox
-    applyInsertEasterEggs();
+    updatePool.parallelFor(numChunks, [this](unsigned int chunk)
+    {
+        auto &commands = updateCommands[chunk];
+        size_t end = std::min(animationTimers.size(), size_t(chunk + 1) * updateChunkSize);
 
-    return true;
-}
+        for(size_t i = chunk * updateChunkSize; i < end; i++)
+            stepAnimation(*animationTimers[i], commands);
+    });
 
-void World::update(uint32_t deltaMs, SoundMixer &sound)
-{
-    for(auto &object : objects)
-        object.update(deltaMs, sound);
+    for(unsigned int i = 0; i < numChunks; i++)
+        applyCommands(updateCommands[i], sound);
 
-    for(auto &train : trains)
-        train.update(deltaMs, sound);
+    lap(updateTimes.animations);
+
+    // these can add objects, so stay on this thread
+    for(auto &timer : firedTimers)
+    {
+        if(timer.data.type == TimerEvent::Type::TimeEvent)
+            runTimeEvent(timer.data.value);
+    }
 
-    updateTimeEasterEggs(deltaMs);
+    lap(updateTimes.timeEvents);
 
-    //remove dead objects
-    objects.erase(std::remove_if(objects.begin(), objects.end(), [](auto &obj){return obj.getId() == 0xFFFF;}), objects.end());
+    // time events may have changed something
+    if(trackGraphDirty)
+        updateTrackGraph();
+
+    for(auto &train : trains)
+    {
+        if(train.update(deltaMs, sound))
+            redrawNeeded = true;
+    }
+
+    lap(updateTimes.trains);
 }
 
 void World::handleEvent(SDL_Event &event)
 {
     switch(event.type)
     {
+        case SDL_WINDOWEVENT:
+        {
+            if(event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+                setWindowSize(event.window.data1, event.window.data2);
+            break;
+        }
+
         case SDL_MOUSEWHEEL:
         {
             if(event.wheel.y != 0)
@@ -249,10 +325,9 @@ void World::handleEvent(SDL_Event &event)
                 zoom = std::min(4.0f, std::max(1.0f, zoom));
 
                 // adjust scroll
-                // need to convert coords for hidpi
-                auto renderer = SDL_GetRenderer(SDL_GetWindowFromID(event.wheel.windowID));
-                float logMouseX, logMouseY;
-                SDL_RenderWindowToLogical(renderer, event.wheel.mouseX, event.wheel.mouseY, &logMouseX, &logMouseY);
+                // mouse coords are already converted to renderer coords (for hidpi)
+                float logMouseX = event.wheel.mouseX;
+                float logMouseY = event.wheel.mouseY;
 
                 // convert to world coord
                 float mouseWorldX = (logMouseX + scrollX) / oldZoom;
@@ -267,6 +342,7 @@ void World::handleEvent(SDL_Event &event)
                 scrollY += (newMouseY - logMouseY);
 
                 clampScroll();
+                redrawNeeded = true;
             }
             break;
         }
@@ -305,50 +381,353 @@ void World::handleEvent(SDL_Event &event)
                 default:
                     break;
             }
+            redrawNeeded = true;
             break;
         }
+
     }
 }
 
-void World::render(SDL_Renderer *renderer)
+void World::saveState(std::vector<uint8_t> &state) const
 {
-    // set clipping
-    SDL_Rect clip{
-        -scrollX, -scrollY,
-        static_cast<int>(width * tileSize * zoom),
-        static_cast<int>(height * tileSize * zoom)
-    };
+    static_assert(std::is_trivially_copyable_v<decltype(randomGen)>);
+
+    state.clear();
+    StateWriter writer(state);
+
+    writer.write(randomGen);
+    writer.write(dateTimeMs);
+
+    std::vector<TimerWheel<TimerEvent>::Timer> savedTimers;
+    timers.getTimers(savedTimers);
+
+    writer.write(timers.getTime());
+    writer.writeVector(savedTimers);
+
+    // every slot, so that handles stay valid and new objects go in the same places
+    auto capacity = objects.getCapacity();
+
+    writer.write(capacity);
+    writer.write(objects.getFreeHead());
+    writer.write(nextObjectSerial);
+
+    for(uint32_t i = 0; i < capacity; i++)
+    {
+        auto slot = objects.getSlotState(i);
+        writer.write(slot.generation);
+        writer.write(slot.used);
+
+        if(slot.used)
+        {
+            auto object = objects.getAt(i);
+            writer.write(object->getId());
+            writer.write(object->getState());
+
+            // needed to recreate it if it gets removed/replaced
+            writer.writeString(object->getName());
+            writer.write(uint32_t(object->getMinifigs().size()));
+
+            for(auto &minifig : object->getMinifigs())
+            {
+                writer.write(minifig.id);
+                writer.writeString(minifig.name);
+            }
+        }
+        else
+            writer.write(slot.nextFree);
+    }
+
+    writer.writeVector(movingObjects);
+
+    writer.write(uint32_t(trains.size()));
+
+    for(auto &train : trains)
+        train.saveState(writer);
+}
+
+bool World::restoreState(const std::vector<uint8_t> &state)
+{
+    StateReader reader(state);
+
+    uint64_t timerTime;
+    std::vector<TimerWheel<TimerEvent>::Timer> savedTimers;
+
+    if(!reader.read(randomGen) || !reader.read(dateTimeMs) || !reader.read(timerTime) || !reader.readVector(savedTimers))
+        return false;
+
+    timers.restore(timerTime, savedTimers);
+
+    uint32_t capacity, freeHead;
+
+    if(!reader.read(capacity) || !reader.read(freeHead) || !reader.read(nextObjectSerial))
+        return false;
+
+    for(uint32_t i = 0; i < capacity; i++)
+    {
+        uint32_t generation;
+        bool used;
+
+        if(!reader.read(generation) || !reader.read(used))
+            return false;
+
+        if(used)
+        {
+            uint16_t id;
+            Object::State objectState;
+            std::string name;
+            uint32_t numMinifigs;
+
+            if(!reader.read(id) || !reader.read(objectState) || !reader.readString(name) || !reader.read(numMinifigs))
+                return false;
+
+            std::vector<Minifig> minifigs;
+
+            for(uint32_t j = 0; j < numMinifigs; j++)
+            {
+                Minifig minifig;
+
+                if(!reader.read(minifig.id) || !reader.readString(minifig.name))
+                    return false;
+
+                minifigs.emplace_back(std::move(minifig));
+            }
+
+            // only recreate objects that were removed/replaced
+            auto object = objects.getAt(i);
 
-    SDL_Rect oldClip;
-    SDL_RenderGetClipRect(renderer, &oldClip);
+            if(object && object->getId() == id && object->getName() == name)
+                objects.setGenerationAt(i, generation);
+            else
+                object = &objects.emplaceAt({i, generation}, createObject(id, 0, 0, name));
 
-    SDL_RenderSetClipRect(renderer, &clip);
+            object->setState(objectState);
+            object->setMinifigs(std::move(minifigs));
+        }
+        else
+        {
+            uint32_t nextFree;
+
+            if(!reader.read(nextFree))
+                return false;
+
+            objects.resetAt(i, generation, nextFree);
+        }
+    }
 
-    if(backdrop)
+    objects.restoreFreeList(capacity, freeHead);
+
+    uint32_t numTrains;
+
+    if(!reader.readVector(movingObjects) || !reader.read(numTrains) || numTrains != trains.size())
+        return false;
+
+    for(auto &train : trains)
     {
-        // TODO: repeat/scale?
-        SDL_Rect r = {-scrollX, -scrollY, 0, 0};
-        SDL_QueryTexture(backdrop.get(), nullptr, nullptr, &r.w, &r.h);
-        r.w *= zoom;
-        r.h *= zoom;
-        SDL_RenderCopy(renderer, backdrop.get(), nullptr, &r);
+        if(!train.restoreState(reader))
+            return false;
     }
 
+    // everything needs drawing again
+    resetChunks();
+    redrawNeeded = true;
+
+    trackGraphDirty = true;
+
+    return reader.atEnd();
+}
+
+void World::takeSaveSnapshot(SaveSnapshot &snapshot) const
+{
+    // fixed size and null terminated
+    auto copyName = [](char (&dst)[12], const std::string &src)
+    {
+        memset(dst, 0, sizeof(dst));
+        memcpy(dst, src.data(), std::min(src.size(), sizeof(dst) - 1));
+    };
+
+    snapshot.width = width;
+    snapshot.height = height;
+
+    // just the name
+    snapshot.backdrop = std::filesystem::path(backdropPath).stem().string();
+
+    snapshot.tileTypes.assign(tileObjectType, tileObjectType + size_t(width) * height);
+
+    snapshot.objects.clear();
+    snapshot.minifigs.clear();
+    snapshot.trains.clear();
+
+    snapshot.objects.reserve(objects.size());
+
+    // in creation order, so that reloading keeps the same drawing order
+    std::vector<const Object *> sorted;
+    sorted.reserve(objects.size());
+
     for(auto &object : objects)
-        object.render(renderer, scrollX, scrollY, 1, zoom);
+        sorted.push_back(&object);
+
+    std::sort(sorted.begin(), sorted.end(), [](const Object *a, const Object *b){return a->getSerial() < b->getSerial();});
+
+    for(auto objectPtr : sorted)
+    {
+        auto &object = *objectPtr;
+
+        if(object.isMoving())
+            continue;
 
-    // TODO: minifigs
+        auto &minifigs = object.getMinifigs();
+
+        SaveSnapshot::Object savedObject;
+        savedObject.id = object.getId();
+        savedObject.x = object.getX();
+        savedObject.y = object.getY();
+        savedObject.frameset = std::max(0, object.getAnimation());
+        copyName(savedObject.name, object.getName());
+        savedObject.numMinifigs = std::min(minifigs.size(), size_t(5));
+
+        snapshot.objects.push_back(savedObject);
+
+        for(unsigned int i = 0; i < savedObject.numMinifigs; i++)
+        {
+            SaveSnapshot::Minifig savedMinifig;
+            savedMinifig.id = minifigs[i].id;
+            copyName(savedMinifig.name, minifigs[i].name);
+
+            snapshot.minifigs.push_back(savedMinifig);
+        }
+    }
 
     for(auto &train : trains)
-        train.render(renderer, scrollX, scrollY, zoom);
+    {
+        SaveSnapshot::Train savedTrain{};
+
+        // only room for three carriages
+        auto ids = train.getPartIds();
+        std::copy(ids.begin(), ids.begin() + std::min(ids.size(), size_t(4)), savedTrain.ids);
+        std::copy(train.getPartTypes(), train.getPartTypes() + 4, savedTrain.types);
+
+        copyName(savedTrain.name, train.getName());
+
+        snapshot.trains.push_back(savedTrain);
+    }
+}
+
+bool World::getRedrawNeeded() const
+{
+    return redrawNeeded;
+}
+
+void World::setRedrawNeeded()
+{
+    redrawNeeded = true;
+}
+
+void World::takeSnapshot(RenderSnapshot &snapshot)
+{
+    // reuses the old snapshot's memory
+    snapshot.dynamicObjects.clear();
+    snapshot.trainParts.clear();
+
+    // static objects can't change without invalidating a chunk
+    // (a new list, the old one may still be in use by the renderer)
+    std::shared_ptr<std::vector<RenderSnapshot::Sprite>> newStaticSprites;
+
+    if(!staticSprites || staticSpritesVersion != lastChunkVersion)
+    {
+        newStaticSprites = std::make_shared<std::vector<RenderSnapshot::Sprite>>();
+        newStaticSprites->reserve(objects.size());
+    }
+
+    for(auto &object : objects)
+    {
+        if(!object.isStatic())
+            snapshot.dynamicObjects.push_back(object.getSprite());
+        else if(newStaticSprites)
+            newStaticSprites->push_back(object.getSprite());
+    }
+
+    // slots are reused, but objects are drawn in the order they were created
+    auto sortByOrder = [](std::vector<RenderSnapshot::Sprite> &sprites)
+    {
+        auto byOrder = [](const RenderSnapshot::Sprite &a, const RenderSnapshot::Sprite &b){return a.order < b.order;};
 
-    for(int z = 2; z < 7; z++)
+        if(!std::is_sorted(sprites.begin(), sprites.end(), byOrder))
+            std::sort(sprites.begin(), sprites.end(), byOrder);
+    };
+
+    sortByOrder(snapshot.dynamicObjects);
+
+    if(newStaticSprites)
     {
-        for(auto &object : objects)
-            object.render(renderer, scrollX, scrollY, z, zoom);
+        sortByOrder(*newStaticSprites);
+        staticSprites = std::move(newStaticSprites);
+        staticSpritesVersion = lastChunkVersion;
     }
 
-    SDL_RenderSetClipRect(renderer, &oldClip);
+    snapshot.staticObjects = staticSprites;
+
+    for(auto &train : trains)
+        train.getSprites(snapshot.trainParts);
+
+    // static objects never move
+    auto isMoving = [](const RenderSnapshot::Sprite &sprite)
+    {
+        return sprite.pixelX != sprite.lastPixelX || sprite.pixelY != sprite.lastPixelY;
+    };
+
+    snapshot.moving = std::any_of(snapshot.dynamicObjects.begin(), snapshot.dynamicObjects.end(), isMoving)
+                   || std::any_of(snapshot.trainParts.begin(), snapshot.trainParts.end(), isMoving);
+
+    snapshot.width = width;
+    snapshot.height = height;
+    snapshot.backdrop = backdrop;
+
+    snapshot.scrollX = scrollX;
+    snapshot.scrollY = scrollY;
+    snapshot.zoom = zoom;
+    snapshot.windowWidth = windowWidth;
+    snapshot.windowHeight = windowHeight;
+
+    snapshot.chunksX = chunksX;
+    snapshot.chunksY = chunksY;
+    snapshot.chunkVersions = chunkVersions;
+
+    redrawNeeded = false;
+}
+
+// time until the next update that could change something
+uint32_t World::getNextUpdateDelay() const
+{
+    if(!movingObjects.empty())
+        return 0;
+
+    uint32_t delay = timers.getNextDelay();
+
+    for(auto &train : trains)
+        delay = std::min(delay, train.getNextUpdateDelay());
+
+    return delay;
+}
+
+void World::setDateTime(int64_t dateTime)
+{
+    dateTimeMs = dateTime * 1000;
+}
+
+int64_t World::getDateTime() const
+{
+    return dateTimeMs / 1000;
+}
+
+void World::setUpdateTimesEnabled(bool enabled)
+{
+    updateTimesEnabled = enabled;
+    updateTimes = {};
+}
+
+const World::UpdateTimes &World::getUpdateTimes() const
+{
+    return updateTimes;
 }
 
 void World::setWindowSize(unsigned int windowWidth, unsigned int windowHeight)
@@ -357,6 +736,7 @@ void World::setWindowSize(unsigned int windowWidth, unsigned int windowHeight)
     this->windowHeight = windowHeight;
 
     clampScroll();
+    redrawNeeded = true;
 }
 
 ObjectDataStore &World::getObjectDataStore()
@@ -365,6 +745,13 @@ ObjectDataStore &World::getObjectDataStore()
 }
 
 Object World::createObject(uint16_t id, uint16_t x, uint16_t y, std::string name)
+{
+    auto [texture, data] = getObjectResources(id);
+
+    return {id, x, y, name, texture, data, objectStates};
+}
+
+std::tuple<std::shared_ptr<Texture>, const ObjectData *> World::getObjectResources(uint16_t id)
 {
     // attempt to get texture
     auto texture = texLoader.loadTexture(id);
@@ -375,21 +762,100 @@ Object World::createObject(uint16_t id, uint16_t x, uint16_t y, std::string name
     // set alpha if semi-transparent
     // assumes this object is the only user of the image
     if(data && texture && data->semiTransparent)
-        SDL_SetTextureAlphaMod(texture.get(), 127);
+        texture->alpha = 127;
 
-    return {id, x, y, name, texture, data};
+    return {texture, data};
 }
 
-Object &World::addObject(uint16_t id, uint16_t x, uint16_t y, std::string name)
+World::ObjectHandle World::addObject(uint16_t id, uint16_t x, uint16_t y, std::string name)
 {
-    return objects.emplace_back(std::move(createObject(id, x, y, name)));
+    auto handle = objects.emplace(createObject(id, x, y, name));
+    auto &object = *objects.get(handle);
+
+    object.setSerial(nextObjectSerial++);
+
+    // even if not static, cached objects may need to be drawn around it
+    invalidateChunks(object);
+
+    if(object.getData() && !object.getData()->coords.empty())
+        trackGraphDirty = true;
+
+    scheduleAnimation(handle);
+
+    redrawNeeded = true;
+
+    return handle;
+}
+
+bool World::setObjectAnimation(ObjectHandle handle, int index)
+{
+    auto object = objects.get(handle);
+
+    if(!object || !object->setAnimation(index))
+        return false;
+
+    scheduleAnimation(handle);
+
+    // not static while the change is pending
+    invalidateChunks(*object);
+    redrawNeeded = true;
+
+    return true;
+}
+
+bool World::setObjectAnimation(ObjectHandle handle, std::string_view name)
+{
+    auto object = objects.get(handle);
+
+    if(!object || !object->setAnimation(name))
+        return false;
+
+    scheduleAnimation(handle);
+
+    // not static while the change is pending
+    invalidateChunks(*object);
+    redrawNeeded = true;
+
+    return true;
+}
+
+void World::removeObject(ObjectHandle handle)
+{
+    auto object = objects.get(handle);
+
+    if(!object)
+        return;
+
+    invalidateChunks(*object);
+
+    if(object->getData() && !object->getData()->coords.empty())
+        trackGraphDirty = true;
+
+    objects.destroy(handle);
+
+    redrawNeeded = true;
+}
+
+Object *World::getObject(ObjectHandle handle)
+{
+    return objects.get(handle);
 }
 
 Object *World::getObjectAt(unsigned int x, unsigned int y)
 {
+    return objects.get(getObjectHandleAt(x, y));
+}
+
+World::ObjectHandle World::getObjectHandleAt(unsigned int x, unsigned int y)
+{
+    // the first created object wins if several overlap
+    ObjectHandle ret;
+    uint32_t retSerial = ~0u;
+
     // TODO: add some kind of lookup table for this
-    for(auto &object : objects)
+    for(auto it = objects.begin(); it != objects.end(); ++it)
     {
+        auto &object = *it;
         auto objectData = object.getData();
         if(!objectData)
             continue;
@@ -414,25 +880,28 @@ Object *World::getObjectAt(unsigned int x, unsigned int y)
         int relX = x - objectX;
         int relY = y - (objectY + yAdjust);
 
-        if(objectData->physicalOccupancy[relX + relY * objectData->physSizeX])
-            return &object;
+        if(objectData->physicalOccupancy[relX + relY * objectData->physSizeX] && object.getSerial() < retSerial)
+        {
+            ret = it.getHandle();
+            retSerial = object.getSerial();
+        }
     }
 
-    return nullptr;
+    return ret;
 }
 
-std::vector<Object *> World::getTunnels(bool shuffled)
+std::vector<World::ObjectHandle> World::getTunnels(bool shuffled)
 {
-    std::vector<Object *> ret;
+    std::vector<ObjectHandle> ret;
 
-    for(auto &object : objects)
+    for(auto it = objects.begin(); it != objects.end(); ++it)
     {
-        auto objectData = object.getData();
+        auto objectData = it->getData();
         if(!objectData)
             continue;
  
         if(objectData->specialType == ObjectData::SpecialType::Tunnel)
-            ret.push_back(&object);
+            ret.push_back(it.getHandle());
     }
 
     if(shuffled)
@@ -441,6 +910,20 @@ std::vector<Object *> World::getTunnels(bool shuffled)
     return ret;
 }
 
+const TrackGraph &World::getTrackGraph() const
+{
+    return trackGraph;
+}
+
+std::string World::getBackdropPath(std::string_view backdropName)
+{
+    // default to "backdrop"
+    std::string ret = "backdrop/";
+    ret.append(backdropName.empty() ? "backdrop" : backdropName).append(".bmp");
+
+    return ret;
+}
+
 // load the "global" easter eggs from EE.INI
 void World::loadEasterEggs()
 {
@@ -563,7 +1046,8 @@ void World::loadEasterEggs()
 
             // init timer
             std::uniform_int_distribution distribution(10, timeEvent.periodMax);
-            timeEvent.periodTimer = distribution(randomGen) * 1000;
+            unsigned int index = timeEvents.size();
+            timers.schedule(distribution(randomGen) * 1000, {TimerEvent::Type::TimeEvent, {}, index});
     
             timeEvents.emplace_back(timeEvent);
         }
@@ -617,6 +1101,113 @@ void World::loadEasterEggs()
     }
 }
 
+void World::updateTrackGraph()
+{
+    trackGraph.build(objects, movingObjects, width, height);
+    trackGraphDirty = false;
+}
+
+void World::resetChunks()
+{
+    chunksX = (width + chunkSize - 1) / chunkSize;
+    chunksY = (height + chunkSize - 1) / chunkSize;
+
+    // everything needs drawing again
+    chunkVersions.assign(chunksX * chunksY, ++lastChunkVersion);
+}
+
+void World::invalidateChunks(const Object &object)
+{
+    auto data = object.getData();
+
+    if(!data || chunkVersions.empty())
+        return;
+
+    // bitmap bounds, in chunks
+    int minX = std::max(0, object.getX() / chunkSize);
+    int minY = std::max(0, object.getY() / chunkSize);
+    int maxX = std::min(static_cast<int>(chunksX) - 1, static_cast<int>(object.getX() + data->bitmapSizeX - 1) / chunkSize);
+    int maxY = std::min(static_cast<int>(chunksY) - 1, static_cast<int>(object.getY() + data->bitmapSizeY - 1) / chunkSize);
+
+    auto version = ++lastChunkVersion;
+
+    for(int y = minY; y <= maxY; y++)
+    {
+        for(int x = minX; x <= maxX; x++)
+            chunkVersions[x + y * chunksX] = version;
+    }
+}
+
+// picks up a changed animation on the next update
+void World::scheduleAnimation(ObjectHandle handle)
+{
+    auto object = objects.get(handle);
+
+    if(!object || !object->isAnimationPending())
+        return;
+
+    // anything scheduled for the old animation gets ignored
+    timers.schedule(0, {TimerEvent::Type::Animation, handle, object->newAnimationSerial()});
+}
+
+// called from multiple threads, only modifies the object and commands
+void World::stepAnimation(const TimerWheel<TimerEvent>::Timer &timer, UpdateCommands &commands)
+{
+    auto &event = timer.data;
+    auto object = objects.get(event.object);
+
+    // removed, or the animation was changed since this was scheduled
+    if(!object || object->getAnimationSerial() != event.value)
+        return;
+
+    bool wasStatic = object->isStatic();
+
+    uint64_t time = timer.expiry;
+    uint64_t now = timers.getTime();
+
+    int delay;
+    bool changed = object->stepAnimation(time, commands.sounds, delay);
+
+    // catch up if the next step was also due (or there was no restartDelay)
+    while(delay >= 0 && time + delay <= now)
+    {
+        time += delay;
+        changed = object->stepAnimation(time, commands.sounds, delay) || changed;
+    }
+
+    if(delay > 0)
+        commands.timers.push_back({time + delay, event});
+
+    bool isStatic = object->isStatic();
+
+    // cached object changed, or object moved in/out of the cache
+    if((changed && isStatic) || wasStatic != isStatic)
+        commands.invalidatedObjects.push_back(object);
+
+    if(changed)
+        commands.redrawNeeded = true;
+}
+
+void World::applyCommands(UpdateCommands &commands, SoundMixer &sound)
+{
+    for(auto &request : commands.sounds)
+        request.object->playSound(request, sound);
+
+    for(auto &timer : commands.timers)
+        timers.scheduleAt(timer.expiry, timer.data);
+
+    for(auto &object : commands.invalidatedObjects)
+        invalidateChunks(*object);
+
+    if(commands.redrawNeeded)
+        redrawNeeded = true;
+
+    commands.sounds.clear();
+    commands.timers.clear();
+    commands.invalidatedObjects.clear();
+    commands.redrawNeeded = false;
+}
+
 void World::clampScroll()
 {
     unsigned int worldWidth = width * tileSize * zoom;
@@ -640,15 +1231,42 @@ void World::clampScroll()
     clampDim(worldHeight, windowHeight, scrollY);
 }
 
+// broken down simulated date/time
+std::tm World::getLocalTime() const
+{
+    auto seconds = getDateTime();
+    auto days = seconds / 86400;
+    int secondOfDay = static_cast<int>(seconds - days * 86400);
+
+    if(secondOfDay < 0)
+    {
+        days--;
+        secondOfDay += 86400;
+    }
+
+    int y, m, d;
+    civilFromDays(days, y, m, d);
+
+    std::tm tm{};
+    tm.tm_year = y - 1900;
+    tm.tm_mon = m - 1;
+    tm.tm_mday = d;
+    tm.tm_hour = secondOfDay / 3600;
+    tm.tm_min = secondOfDay / 60 % 60;
+    tm.tm_sec = secondOfDay % 60;
+    tm.tm_wday = static_cast<int>(((days + 4) % 7 + 7) % 7); // 1970-01-01 was a thursday
+
+    return tm;
+}
+
 void World::applyLoadEasterEggs()
 {
     std::map<int, int> idMap;
 
-    auto time = std::time(nullptr);
-    auto tm = std::localtime(&time);
+    auto tm = getLocalTime();
 
-    int month = tm->tm_mon + 1;
-    int day = tm->tm_mday;
+    int month = tm.tm_mon + 1;
+    int day = tm.tm_mday;
 
     // annoyingly, we don't have the id of the backdrop
     // only its name... which might be in uppercase and won't match the value in the string table
@@ -688,16 +1306,22 @@ void World::applyLoadEasterEggs()
 
     std::cout << idMap.size() << " load events for date " << day << "/" << month << std::endl;
 
-    for(auto &object : objects)
+    for(auto objIt = objects.begin(); objIt != objects.end(); ++objIt)
     {
+        auto &object = *objIt;
+
         // this doesn't have all the logic that insert has, but these usually don't change the size
         auto it = idMap.find(object.getId());
 
         if(it != idMap.end())
         {
+            invalidateChunks(object);
+
             object.replace(it->second, texLoader.loadTexture(it->second), objectDataStore.getObject(it->second));
+            trackGraphDirty = true;
 
             object.setDefaultAnimation(); // saved animation may not exist in the new object
+            scheduleAnimation(objIt.getHandle());
         }
     }
 
@@ -706,9 +1330,11 @@ void World::applyLoadEasterEggs()
 
 void World::applyInsertEasterEggs()
 {
-    for(size_t i = 0; i < objects.size(); i++)
+    // adding objects doesn't move the others, so this is safe
+    // (and new objects are checked too)
+    for(auto it = objects.begin(); it != objects.end(); ++it)
     {
-        auto &object = objects[i];
+        auto &object = *it;
         auto objectData = object.getData();
 
         if(!objectData)
@@ -792,19 +1418,28 @@ void World::applyInsertEasterEggs()
                 {
                     for(unsigned int x = 0; x < newData->physSizeX; x++)
                     {
-                        auto overlapObj = getObjectAt(newX + x, newY + y + yAdjust);
-                        // set an invalid id, we'll remove them later
+                        auto overlapHandle = getObjectHandleAt(newX + x, newY + y + yAdjust);
+                        auto overlapObj = objects.get(overlapHandle);
+
                         if(overlapObj && overlapObj != &object)
-                            overlapObj->replace(0xFFFF);
+                            removeObject(overlapHandle);
                     }
                 }
 
+                invalidateChunks(object);
+
                 object.setPosition(newX, newY);
                 object.replace(easterEgg.changeId, texLoader.loadTexture(easterEgg.changeId), newData);
+                trackGraphDirty = true;
+
+                invalidateChunks(object);
             }
 
             if(easterEgg.changeFrameset != -1)
+            {
                 object.setAnimation(easterEgg.changeFrameset);
+                scheduleAnimation(it.getHandle());
+            }
 
             // minifig values are used to store an offset, so skip those
 
@@ -817,124 +1452,122 @@ void World::applyInsertEasterEggs()
                 // adjust y for physical vs bitmap size
                 newY += oldYAdjust;
 
-                auto &newObject = addObject(easterEgg.newId, newX, newY, "");
+                auto newHandle = addObject(easterEgg.newId, newX, newY, "");
+                auto &newObject = *objects.get(newHandle);
                 newObject.setAnimation(easterEgg.newFrameset);
+                scheduleAnimation(newHandle);
                 auto newObjectData = newObject.getData();
 
                 if(newObjectData && newObjectData->bitmapOccupancy.empty())
                 {
                     // objects without occupancy seem to use pixel offsets
                     // (rainbow)
-                    newObject.setPixelPos(objects[i].getX() * tileSize + easterEgg.x, (objects[i].getY() + oldYAdjust) * tileSize + easterEgg.y);
+                    newObject.setPixelPos(object.getX() * tileSize + easterEgg.x, (object.getY() + oldYAdjust) * tileSize + easterEgg.y);
                 }
             }
         }
     }
-
-    // clean up removed objects
-    objects.erase(std::remove_if(objects.begin(), objects.end(), [](auto &obj){return obj.getId() == 0xFFFF;}), objects.end());
 }
 
-void World::updateTimeEasterEggs(uint32_t deltaMs)
+void World::runTimeEvent(unsigned int index)
 {
-    auto time = std::time(nullptr);
-    auto tm = std::localtime(&time);
-    
-    int month = tm->tm_mon + 1;
-    int day = tm->tm_mday;
+    auto &event = timeEvents[index];
 
-    int hour = tm->tm_hour;
-    int min = tm->tm_min;
+    // restart timer
+    std::uniform_int_distribution distribution(10, event.periodMax);
+    timers.schedule(distribution(randomGen) * 1000, {TimerEvent::Type::TimeEvent, {}, index});
 
-    for(auto &event : timeEvents)
-    {
-        event.periodTimer -= deltaMs;
+    auto tm = getLocalTime();
 
-        if(event.periodTimer < 0)
-        {
-            // restart timer
-            std::uniform_int_distribution distribution(10, event.periodMax);
-            event.periodTimer += distribution(randomGen) * 1000;
+    int month = tm.tm_mon + 1;
+    int day = tm.tm_mday;
 
-            // outside months (month == 0 is "any")
-            if(event.startMonth && month < event.startMonth)
-                continue;
+    int hour = tm.tm_hour;
+    int min = tm.tm_min;
 
-            if(event.endMonth && month > event.endMonth)
-                continue;
 
-            // before start date
-            if(day < event.startDay && (!event.startMonth || month == event.startMonth))
-                continue;
+    // outside months (month == 0 is "any")
+    if(event.startMonth && month < event.startMonth)
+        return;
 
-            // after end date
-            if(day > event.endDay && (!event.endMonth || month == event.endMonth))
-                continue;
+    if(event.endMonth && month > event.endMonth)
+        return;
 
-            // check time
-            // all the events in EE.INI have a time range of 01:00 - 23:00, so nothing happens for two hours at night...
-            if(hour < event.startHour || hour > event.endHour)
-                continue;
+    // before start date
+    if(day < event.startDay && (!event.startMonth || month == event.startMonth))
+        return;
 
-            if(min < event.startMin && hour == event.startHour)
-                continue;
+    // after end date
+    if(day > event.endDay && (!event.endMonth || month == event.endMonth))
+        return;
 
-            if(min > event.endMin && hour == event.endHour)
-                continue;
+    // check time
+    // all the events in EE.INI have a time range of 01:00 - 23:00, so nothing happens for two hours at night...
+    if(hour < event.startHour || hour > event.endHour)
+        return;
 
-            // finally create the object
+    if(min < event.startMin && hour == event.startHour)
+        return;
 
-            // TODO: cant/must have data
+    if(min > event.endMin && hour == event.endHour)
+        return;
 
-            int x = event.x;
-            int y = event.y;
+    // finally create the object
 
-            bool xNonZero = x != 0;
+    // TODO: cant/must have data
 
-            // random pos if -1
-            if(x == -1)
-                x = std::uniform_int_distribution<int>(0, width * tileSize)(randomGen);
+    int x = event.x;
+    int y = event.y;
 
-            if(y == -1)
-                y = std::uniform_int_distribution<int>(0, height * tileSize)(randomGen);
+    bool xNonZero = x != 0;
 
-            auto &object = addObject(event.resId, x, y, "");
-            object.setAnimation(event.resFrameset);
+    // random pos if -1
+    if(x == -1)
+        x = std::uniform_int_distribution<int>(0, width * tileSize)(randomGen);
 
-            // set up movement
-            int targetX, targetY;
-            int velX = 0, velY = 0;
-            int speed = 35 * std::uniform_int_distribution(1, 3)(randomGen); // rough pixels/s from a lot of in-game cloud watching
+    if(y == -1)
+        y = std::uniform_int_distribution<int>(0, height * tileSize)(randomGen);
 
-            auto objectSize = object.getFrameSize();
+    auto handle = addObject(event.resId, x, y, "");
+    auto &object = *objects.get(handle);
+    object.setAnimation(event.resFrameset);
+    scheduleAnimation(handle);
 
-            switch(event.type)
-            {
-                case ObjectMotion::None:
-                    break;
-                
-                case ObjectMotion::Port:
-                    targetY = y;
-                    // if x was zero there is no target so scroll to the opposite side
-                    targetX = xNonZero ? x : -std::get<0>(objectSize);
-                    object.setX(width * tileSize);
-
-                    velX = -speed;
-                    break;
+    // set up movement
+    int targetX, targetY;
+    int velX = 0, velY = 0;
+    int speed = 35 * std::uniform_int_distribution(1, 3)(randomGen); // rough pixels/s from a lot of in-game cloud watching
 
-                case ObjectMotion::Starboard:
-                    targetY = y;
-                    targetX = xNonZero ? x : width * tileSize;
-                    object.setX(-std::get<0>(objectSize));
+    auto objectSize = object.getFrameSize();
 
-                    velX = speed;
-                    break;
-            }
+    switch(event.type)
+    {
+        case ObjectMotion::None:
+            break;
+        
+        case ObjectMotion::Port:
+            targetY = y;
+            // if x was zero there is no target so scroll to the opposite side
+            targetX = xNonZero ? x : -std::get<0>(objectSize);
+            object.setX(width * tileSize);
+
+            velX = -speed;
+            break;
 
-            object.setPixelPos(object.getX(), object.getY());
+        case ObjectMotion::Starboard:
+            targetY = y;
+            targetX = xNonZero ? x : width * tileSize;
+            object.setX(-std::get<0>(objectSize));
 
-            // reverse back to start if x was specified
-            object.setTargetPos(targetX, targetY, velX, velY, xNonZero);
-        }
+            velX = speed;
+            break;
     }
+
+    object.setPixelPos(object.getX(), object.getY());
+
+    // reverse back to start if x was specified
+    object.setTargetPos(targetX, targetY, velX, velY, xNonZero);
+
+    if(velX || velY)
+        movingObjects.push_back(handle);
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include <SDL.h>
 
+#include <chrono>
+#include <ctime>
 #include <filesystem>
 #include <random>
 #include <string>
@@ -9,34 +11,104 @@
 
 #include "Object.hpp"
 #include "ObjectDataStore.hpp"
+#include "RenderSnapshot.hpp"
+#include "SlotMap.hpp"
 #include "TextureLoader.hpp"
+#include "ThreadPool.hpp"
+#include "TimerWheel.hpp"
+#include "TrackGraph.hpp"
 #include "Train.hpp"
 
+struct SaveSnapshot;
+
 class World final
 {
 public:
-    World(FileLoader &fileLoader, TextureLoader &texLoader, ObjectDataStore &objectDataStore);
+    using ObjectHandle = SlotMap<Object>::Handle;
+
+    // time spent in each part of update
+    struct UpdateTimes
+    {
+        std::chrono::steady_clock::duration motion{0};
+        std::chrono::steady_clock::duration timers{0};
+        std::chrono::steady_clock::duration animations{0};
+        std::chrono::steady_clock::duration timeEvents{0};
+        std::chrono::steady_clock::duration trains{0};
+    };
+
+    World(FileLoader &fileLoader, TextureLoader &texLoader, ObjectDataStore &objectDataStore, uint32_t randomSeed);
     ~World();
 
+    // .SAV or native (see NativeSave.hpp), replaces whatever is loaded
+    // use a SaveLoader directly to load a bit at a time
     bool loadSave(const std::filesystem::path &path);
 
+    // removes everything from the save, keeping allocations for the next one
+    // (time events, date/time and the random state are kept)
+    void unload();
+
+    // loads the last save again
+    bool reload();
+
+    const std::filesystem::path &getSavePath() const;
+
     void update(uint32_t deltaMs, SoundMixer &sound);
 
+    // window size changes are in renderer pixels (for hidpi)
     void handleEvent(SDL_Event &event);
 
-    void render(SDL_Renderer *renderer);
+    // copies what's needed to draw the world, clears redrawNeeded
+    void takeSnapshot(RenderSnapshot &snapshot);
+
+    // everything that changes while running (objects, animations, timers, trains, random state, date/time)
+    // for rewinding, names and minifigs are included so that removed objects can be recreated
+    void saveState(std::vector<uint8_t> &state) const;
+    bool restoreState(const std::vector<uint8_t> &state);
+
+    // copies what's needed to write a save (see SaveWriter)
+    // objects that are moving (from time events) are skipped
+    void takeSaveSnapshot(SaveSnapshot &snapshot) const;
+
+    bool getRedrawNeeded() const;
+    void setRedrawNeeded();
+
+    uint32_t getNextUpdateDelay() const;
+
+    // totals since enabled, off by default
+    void setUpdateTimesEnabled(bool enabled);
+    const UpdateTimes &getUpdateTimes() const;
 
     void setWindowSize(unsigned int windowWidth, unsigned int windowHeight);
 
+    // simulated local date/time, in seconds since 1970 as if local time were UTC
+    // starts at the real time and advances with update
+    void setDateTime(int64_t dateTime);
+    int64_t getDateTime() const;
+
     ObjectDataStore &getObjectDataStore();
 
     Object createObject(uint16_t id, uint16_t x, uint16_t y, std::string name);
-    Object &addObject(uint16_t id, uint16_t x, uint16_t y, std::string name);
+    ObjectHandle addObject(uint16_t id, uint16_t x, uint16_t y, std::string name);
+    void removeObject(ObjectHandle handle);
+
+    Object *getObject(ObjectHandle handle); // null if removed
+
+    // starts the animation on the next update, false if it doesn't exist
+    bool setObjectAnimation(ObjectHandle handle, int index);
+    bool setObjectAnimation(ObjectHandle handle, std::string_view name);
     Object *getObjectAt(unsigned int x, unsigned int y);
+    ObjectHandle getObjectHandleAt(unsigned int x, unsigned int y);
+
+    std::vector<ObjectHandle> getTunnels(bool shuffled = false);
 
-    std::vector<Object *> getTunnels(bool shuffled = false);
+    // up to date at the start of each train update
+    const TrackGraph &getTrackGraph() const;
+
+    // for the name stored in a save
+    static std::string getBackdropPath(std::string_view backdropName);
 
     static const int tileSize = 16;
+    static const int chunkSize = 32; // in tiles
 
 private:
     enum class ObjectMotion
@@ -60,8 +132,6 @@ private:
         int periodMax;
         ObjectMotion type;
         int x, y;
-
-        int periodTimer;
     };
 
     struct LoadEvent
@@ -72,13 +142,55 @@ private:
         int oldId, newId;
     };
 
+    // things scheduled on the timer wheel
+    struct TimerEvent
+    {
+        enum class Type
+        {
+            Animation,
+            TimeEvent
+        };
+
+        Type type;
+        ObjectHandle object;
+        uint32_t value; // animation serial or time event index
+    };
+
+    // side effects of updating objects in parallel, applied afterwards
+    struct UpdateCommands
+    {
+        std::vector<Object::SoundRequest> sounds;
+        std::vector<TimerWheel<TimerEvent>::Timer> timers;
+        std::vector<const Object *> invalidatedObjects; // chunks need updating
+        bool redrawNeeded = false;
+    };
+
+    friend class SaveLoader;
+
+    void beginLoad(const std::filesystem::path &path, uint16_t newWidth, uint16_t newHeight, const char *backdropName);
+    void addTrain(const uint32_t ids[4], const uint32_t types[4], const char *name, const std::vector<ObjectHandle> &depots, size_t &depotIndex);
+    void finishLoad();
+
+    std::tuple<std::shared_ptr<Texture>, const ObjectData *> getObjectResources(uint16_t id);
+
     void loadEasterEggs();
 
+    void resetChunks();
+    void invalidateChunks(const Object &object);
+
     void clampScroll();
 
+    void updateTrackGraph();
+
+    std::tm getLocalTime() const;
+
     void applyInsertEasterEggs();
     void applyLoadEasterEggs();
-    void updateTimeEasterEggs(uint32_t deltaMs);
+    void runTimeEvent(unsigned int index);
+
+    void scheduleAnimation(ObjectHandle handle);
+    void stepAnimation(const TimerWheel<TimerEvent>::Timer &timer, UpdateCommands &commands);
+    void applyCommands(UpdateCommands &commands, SoundMixer &sound);
 
     FileLoader &fileLoader;
     TextureLoader &texLoader;
@@ -86,6 +198,8 @@ private:
 
     std::mt19937 randomGen;
 
+    int64_t dateTimeMs = 0;
+
     std::vector<TimeEvent> timeEvents;
     std::vector<LoadEvent> loadEvents;
 
@@ -93,15 +207,50 @@ private:
     int scrollX = 0, scrollY = 0;
     float zoom = 1.0f;
 
+    bool redrawNeeded = true;
+
+    bool updateTimesEnabled = false;
+    UpdateTimes updateTimes;
+
     uint16_t width = 0;
     uint16_t height = 0;
 
+    std::filesystem::path savePath;
+
     uint8_t *tileObjectType = nullptr;
+    size_t tileObjectTypeSize = 0; // allocated
 
     std::string backdropPath;
-    std::shared_ptr<SDL_Texture> backdrop;
+    std::shared_ptr<Texture> backdrop;
+
+    std::vector<std::shared_ptr<Texture>> eventTextures; // for time events, loaded with the save
+
+    ObjectStates objectStates; // needs to outlive objects/trains
+    SlotMap<Object> objects;
+    uint32_t nextObjectSerial = 0; // slots are reused, this keeps the creation order
+    std::vector<ObjectHandle> movingObjects;
+
+    TimerWheel<TimerEvent> timers;
+    std::vector<TimerWheel<TimerEvent>::Timer> firedTimers;
+    std::vector<const TimerWheel<TimerEvent>::Timer *> animationTimers;
+
+    static const unsigned int updateChunkSize = 64; // animations stepped per task
+
+    ThreadPool updatePool;
+    std::vector<UpdateCommands> updateCommands;
+
+    // versions of the static objects in each chunk, for the render thread's cache
+    unsigned int chunksX = 0, chunksY = 0;
+    std::vector<uint32_t> chunkVersions;
+    uint32_t lastChunkVersion = 0;
+
+    // shared by snapshots until lastChunkVersion changes
+    std::shared_ptr<const std::vector<RenderSnapshot::Sprite>> staticSprites;
+    uint32_t staticSpritesVersion = 0;
 
-    std::vector<Object> objects;
+    // rebuilt when track is added/removed
+    TrackGraph trackGraph;
+    bool trackGraphDirty = true;
 
     std::vector<Train> trains;
 };
\ No newline at end of file
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <chrono>
+
+#include "WorldManager.hpp"
+
+#include "Renderer.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+WorldManager::WorldManager(World &world, TextureLoader &texLoader, ObjectDataStore &objectDataStore) : world(world), texLoader(texLoader), objectDataStore(objectDataStore)
+{
+}
+
+void WorldManager::setRotation(std::vector<std::filesystem::path> saves)
+{
+    rotation = std::move(saves);
+    current = 0;
+
+    setPinTarget(~size_t(0));
+}
+
+const std::vector<std::filesystem::path> &WorldManager::getRotation() const
+{
+    return rotation;
+}
+
+size_t WorldManager::getCurrent() const
+{
+    return current;
+}
+
+void WorldManager::switchTo(size_t index)
+{
+    if(index >= rotation.size())
+        return;
+
+    // keeps anything already pinned if it's for this save
+    setPinTarget(index);
+
+    current = index;
+    state = State::Pinning;
+    failed = false;
+    loader.reset();
+}
+
+void WorldManager::switchToNext()
+{
+    if(!rotation.empty())
+        switchTo((current + 1) % rotation.size());
+}
+
+bool WorldManager::update(uint32_t budgetMs, Renderer *renderer)
+{
+    auto endTime = Clock::now() + std::chrono::milliseconds(budgetMs);
+
+    if(state == State::Pinning)
+    {
+        while(pinStep(renderer))
+        {
+            if(budgetMs && Clock::now() >= endTime)
+                return true;
+        }
+
+        // loading unloads the old save, only freeing what the new one doesn't use
+        loader = std::make_unique<SaveLoader>(world, rotation[current]);
+        state = State::Loading;
+    }
+
+    if(state == State::Loading)
+    {
+        uint32_t loadBudget = 0;
+
+        if(budgetMs)
+        {
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - Clock::now()).count();
+            loadBudget = static_cast<uint32_t>(std::max<decltype(remaining)>(1, remaining));
+        }
+
+        if(loader->update(loadBudget))
+            return true;
+
+        failed = loader->getPhase() == SaveLoader::Phase::Failed;
+        state = State::Idle;
+
+        // the world has its own references now
+        setPinTarget(~size_t(0));
+    }
+
+    return false;
+}
+
+bool WorldManager::pinNext(uint32_t budgetMs, Renderer *renderer)
+{
+    if(state != State::Idle || rotation.size() < 2)
+        return false;
+
+    auto next = (current + 1) % rotation.size();
+
+    if(pinTarget != next)
+        setPinTarget(next);
+
+    auto endTime = Clock::now() + std::chrono::milliseconds(budgetMs);
+
+    while(pinStep(renderer))
+    {
+        if(budgetMs && Clock::now() >= endTime)
+            return true;
+    }
+
+    return false;
+}
+
+bool WorldManager::isSwitching() const
+{
+    return state != State::Idle;
+}
+
+bool WorldManager::getFailed() const
+{
+    return failed;
+}
+
+float WorldManager::getProgress() const
+{
+    switch(state)
+    {
+        case State::Idle:
+            return 1.0f;
+
+        case State::Pinning:
+            return assetsRead ? 0.5f * pinIndex / (assets.objectIds.size() + 1) : 0.0f;
+
+        case State::Loading:
+            return 0.5f + 0.5f * loader->getProgress();
+    }
+
+    return 0.0f;
+}
+
+const SaveLoader *WorldManager::getLoader() const
+{
+    return loader.get();
+}
+
+void WorldManager::setPinTarget(size_t index)
+{
+    if(index == pinTarget)
+        return;
+
+    pinTarget = index;
+    assetsRead = false;
+    pinIndex = 0;
+    pinned.clear();
+}
+
+// loads one asset, false when there's nothing left
+bool WorldManager::pinStep(Renderer *renderer)
+{
+    if(!assetsRead)
+    {
+        // if this fails, the loader will complain about it
+        if(!assets.read(rotation[pinTarget]))
+        {
+            assets.backdropPath.clear();
+            assets.objectIds.clear();
+        }
+
+        assetsRead = true;
+        return true;
+    }
+
+    std::shared_ptr<Texture> texture;
+
+    if(pinIndex == 0)
+    {
+        if(!assets.backdropPath.empty())
+            texture = texLoader.loadTexture(assets.backdropPath);
+    }
+    else if(pinIndex <= assets.objectIds.size())
+    {
+        auto id = assets.objectIds[pinIndex - 1];
+
+        texture = texLoader.loadTexture(id);
+        objectDataStore.getObject(id);
+    }
+    else
+        return false;
+
+    pinIndex++;
+
+    if(texture)
+    {
+        if(renderer)
+            renderer->uploadTexture(*texture);
+
+        pinned.push_back(std::move(texture));
+    }
+
+    return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "SaveAssets.hpp"
+#include "SaveLoader.hpp"
+
+class Renderer;
+
+// switches a world between a list of saves, reusing the loaders' caches and the world's allocations
+// the new save's textures/object data are pinned before the old one is unloaded,
+// so anything they share isn't freed and loaded again
+class WorldManager final
+{
+public:
+    WorldManager(World &world, TextureLoader &texLoader, ObjectDataStore &objectDataStore);
+
+    void setRotation(std::vector<std::filesystem::path> saves);
+    const std::vector<std::filesystem::path> &getRotation() const;
+
+    // index of the loaded (or loading) save
+    size_t getCurrent() const;
+
+    // starts switching, then call update until it returns false
+    void switchTo(size_t index);
+    void switchToNext();
+
+    // works on the switch until the budget runs out (0 = no limit), returns false when done
+    // with a renderer, pinned textures are also uploaded, so this should be on the render thread
+    bool update(uint32_t budgetMs, Renderer *renderer = nullptr);
+
+    // pins the next save in the rotation a bit at a time while not switching
+    // (the world can be running, loading is thread safe)
+    // returns false when there's nothing left to do
+    bool pinNext(uint32_t budgetMs, Renderer *renderer = nullptr);
+
+    bool isSwitching() const;
+    bool getFailed() const; // the last switch
+
+    // 0-1, pinning then loading
+    float getProgress() const;
+
+    // null until pinning is done
+    const SaveLoader *getLoader() const;
+
+private:
+    enum class State
+    {
+        Idle,
+        Pinning,
+        Loading
+    };
+
+    void setPinTarget(size_t index);
+    bool pinStep(Renderer *renderer);
+
+    World &world;
+    TextureLoader &texLoader;
+    ObjectDataStore &objectDataStore;
+
+    std::vector<std::filesystem::path> rotation;
+    size_t current = 0;
+
+    State state = State::Idle;
+    bool failed = false;
+
+    // what the save being pinned needs, kept alive until it's loaded
+    size_t pinTarget = ~size_t(0);
+    bool assetsRead = false;
+    SaveAssets assets;
+    size_t pinIndex = 0; // backdrop, then objects
+    std::vector<std::shared_ptr<Texture>> pinned;
+
+    std::unique_ptr<SaveLoader> loader;
+};
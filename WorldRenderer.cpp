@@ -0,0 +1,547 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "WorldRenderer.hpp"
+
+#include "World.hpp"
+
+// merges the static and dynamic objects back into drawing order
+template<class Func>
+static void forEachObject(const RenderSnapshot &snapshot, Func func)
+{
+    auto &dynamicObjects = snapshot.dynamicObjects;
+    auto it = dynamicObjects.begin();
+
+    if(snapshot.staticObjects)
+    {
+        for(auto &sprite : *snapshot.staticObjects)
+        {
+            for(; it != dynamicObjects.end() && it->order < sprite.order; ++it)
+                func(*it);
+
+            func(sprite);
+        }
+    }
+
+    for(; it != dynamicObjects.end(); ++it)
+        func(*it);
+}
+
+void WorldRenderer::render(Renderer &renderer, const RenderSnapshot &snapshot, float alpha)
+{
+    // the world size changed (new save)
+    if(snapshot.chunksX != chunksX || snapshot.chunksY != chunksY)
+    {
+        chunksX = snapshot.chunksX;
+        chunksY = snapshot.chunksY;
+
+        chunks.clear();
+        chunks.resize(chunksX * chunksY);
+    }
+
+    int scrollX = snapshot.scrollX, scrollY = snapshot.scrollY;
+    float zoom = snapshot.zoom;
+
+    if(!renderNativeScale || zoom == 1.0f || !renderer.getTargetsSupported())
+    {
+        renderView(renderer, snapshot, alpha, scrollX, scrollY, zoom, snapshot.windowWidth, snapshot.windowHeight);
+        return;
+    }
+
+    // render the visible area at 1x, then scale the whole thing
+    int viewX = std::floor(scrollX / zoom);
+    int viewY = std::floor(scrollY / zoom);
+
+    // offset of the view inside the window
+    int offsetX = static_cast<int>(viewX * zoom) - scrollX;
+    int offsetY = static_cast<int>(viewY * zoom) - scrollY;
+
+    int viewWidth = std::ceil((snapshot.windowWidth - offsetX) / zoom);
+    int viewHeight = std::ceil((snapshot.windowHeight - offsetY) / zoom);
+
+    // (re)create target if needed
+    if(!offscreen || viewWidth > offscreenWidth || viewHeight > offscreenHeight)
+    {
+        offscreenWidth = std::max(offscreenWidth, viewWidth);
+        offscreenHeight = std::max(offscreenHeight, viewHeight);
+
+        offscreen = renderer.createTarget(offscreenWidth, offscreenHeight);
+
+        if(!offscreen)
+        {
+            std::cerr << "Failed to create offscreen texture (" << SDL_GetError() << ")\n";
+            renderNativeScale = false;
+            renderView(renderer, snapshot, alpha, scrollX, scrollY, zoom, snapshot.windowWidth, snapshot.windowHeight);
+            return;
+        }
+
+    }
+
+    auto oldTarget = renderer.getTarget();
+    renderer.setTarget(offscreen);
+
+    renderer.setDrawColour(0, 0, 0, 255);
+    renderer.clear();
+
+    renderView(renderer, snapshot, alpha, viewX, viewY, 1.0f, viewWidth, viewHeight);
+
+    renderer.setTarget(oldTarget);
+
+    SDL_Rect sr{0, 0, viewWidth, viewHeight};
+    SDL_Rect dr{
+        offsetX, offsetY,
+        static_cast<int>(viewWidth * zoom),
+        static_cast<int>(viewHeight * zoom)
+    };
+
+    renderer.copy(*offscreen, &sr, &dr);
+}
+
+void WorldRenderer::setRenderNativeScale(bool enabled)
+{
+    renderNativeScale = enabled;
+
+    if(!enabled)
+        offscreen.reset();
+}
+
+void WorldRenderer::invalidate()
+{
+    for(auto &chunk : chunks)
+        chunk.version = 0;
+}
+
+void WorldRenderer::renderView(Renderer &renderer, const RenderSnapshot &snapshot, float alpha, int viewX, int viewY, float viewZoom, int viewWidth, int viewHeight)
+{
+    const int tileSize = World::tileSize;
+
+    // find visible chunks
+    bool useChunks = useChunkCache && !chunks.empty() && renderer.getTargetsSupported();
+
+    const int chunkPixels = World::chunkSize * tileSize;
+    int minChunkX = std::max(0, static_cast<int>(viewX / viewZoom) / chunkPixels);
+    int minChunkY = std::max(0, static_cast<int>(viewY / viewZoom) / chunkPixels);
+    int maxChunkX = std::min(static_cast<int>(chunksX) - 1, static_cast<int>((viewX + viewWidth) / viewZoom) / chunkPixels);
+    int maxChunkY = std::min(static_cast<int>(chunksY) - 1, static_cast<int>((viewY + viewHeight) / viewZoom) / chunkPixels);
+
+    // this needs to happen before setting the clip rect, as it changes targets
+    if(useChunks)
+    {
+        updateChunks(renderer, snapshot, minChunkX, minChunkY, maxChunkX, maxChunkY);
+        useChunks = useChunkCache; // may have failed
+    }
+
+    // set clipping
+    SDL_Rect clip{
+        -viewX, -viewY,
+        static_cast<int>(snapshot.width * tileSize * viewZoom),
+        static_cast<int>(snapshot.height * tileSize * viewZoom)
+    };
+
+    SDL_Rect oldClip;
+    renderer.getClipRect(oldClip);
+
+    renderer.setClipRect(&clip);
+
+    if(snapshot.backdrop)
+    {
+        // TODO: repeat/scale?
+        SDL_Rect r = {
+            -viewX, -viewY,
+            static_cast<int>(snapshot.backdrop->width * viewZoom),
+            static_cast<int>(snapshot.backdrop->height * viewZoom)
+        };
+        renderer.copy(*snapshot.backdrop, nullptr, &r);
+    }
+
+    // pixel positioned objects are drawn in the top layer, but aren't in the chunks they overlap
+    // so draw the whole layer directly to keep the order
+    // (these are never static)
+    auto isPixelPositioned = [](const Sprite &sprite){return sprite.data && sprite.texture && sprite.data->bitmapOccupancy.empty();};
+    bool hasPixelSprites = std::any_of(snapshot.dynamicObjects.begin(), snapshot.dynamicObjects.end(), isPixelPositioned);
+
+    renderLayer(renderer, snapshot, alpha, 1, useChunks, viewX, viewY, viewZoom, minChunkX, minChunkY, maxChunkX, maxChunkY);
+
+    // TODO: minifigs
+
+    for(auto &sprite : snapshot.trainParts)
+        renderSprite(renderer, sprite, alpha, viewX, viewY, 6, viewZoom);
+
+    for(int z = 2; z < 7; z++)
+    {
+        bool useLayerChunks = useChunks && (z < 6 || !hasPixelSprites);
+        renderLayer(renderer, snapshot, alpha, z, useLayerChunks, viewX, viewY, viewZoom, minChunkX, minChunkY, maxChunkX, maxChunkY);
+    }
+
+    renderer.setClipRect(&oldClip);
+}
+
+void WorldRenderer::updateChunks(Renderer &renderer, const RenderSnapshot &snapshot, int minX, int minY, int maxX, int maxY)
+{
+    auto isDirty = [this, &snapshot](int x, int y)
+    {
+        int index = x + y * chunksX;
+        return chunks[index].version != snapshot.chunkVersions[index];
+    };
+
+    bool anyDirty = false;
+
+    for(int y = minY; y <= maxY; y++)
+    {
+        for(int x = minX; x <= maxX; x++)
+            anyDirty = anyDirty || isDirty(x, y);
+    }
+
+    if(!anyDirty)
+        return;
+
+    // collect objects for the dirty chunks
+    // dynamic objects aren't drawn, but static objects after them may need to be drawn over them
+    forEachObject(snapshot, [&](const Sprite &sprite)
+    {
+        int objMinX, objMinY, objMaxX, objMaxY;
+
+        if(!getChunkRange(sprite, objMinX, objMinY, objMaxX, objMaxY))
+            return;
+
+        for(int y = std::max(minY, objMinY); y <= std::min(maxY, objMaxY); y++)
+        {
+            for(int x = std::max(minX, objMinX); x <= std::min(maxX, objMaxX); x++)
+            {
+                if(isDirty(x, y))
+                    chunks[x + y * chunksX].objects.push_back(&sprite);
+            }
+        }
+    });
+
+    auto oldTarget = renderer.getTarget();
+
+    for(int y = minY; y <= maxY; y++)
+    {
+        for(int x = minX; x <= maxX; x++)
+        {
+            if(!isDirty(x, y))
+                continue;
+
+            auto &chunk = chunks[x + y * chunksX];
+
+            for(int z = 1; z < 7; z++)
+            {
+                if(!updateChunkLayer(renderer, chunk, x, y, z))
+                {
+                    // give up and draw everything directly
+                    std::cerr << "Failed to create chunk texture (" << SDL_GetError() << ")\n";
+                    useChunkCache = false;
+                    renderer.setTarget(oldTarget);
+                    return;
+                }
+            }
+
+            chunk.objects.clear();
+            chunk.version = snapshot.chunkVersions[x + y * chunksX];
+        }
+    }
+
+    renderer.setTarget(oldTarget);
+}
+
+bool WorldRenderer::updateChunkLayer(Renderer &renderer, Chunk &chunk, int chunkX, int chunkY, int z)
+{
+    // split the static objects so that they're still drawn in order with dynamic objects
+    // a new segment starts when one overlaps a dynamic object that came after the current segment started
+    pendingDynamic.clear();
+    objectSegments.assign(chunk.objects.size(), -1);
+
+    int segment = 0;
+    bool segmentUsed = false;
+
+    for(size_t i = 0; i < chunk.objects.size(); i++)
+    {
+        auto &sprite = *chunk.objects[i];
+
+        if(!sprite.isStatic)
+        {
+            pendingDynamic.push_back(&sprite);
+            continue;
+        }
+
+        bool split = sprite.frameset && sprite.frameset->splitFrames;
+
+        if(!sprite.texture || z > sprite.data->maxBitmapOccupancy + (split ? 1 : 0))
+            continue;
+
+        for(auto &dynamic : pendingDynamic)
+        {
+            if(layerOverlaps(sprite, *dynamic, z))
+            {
+                // an empty segment can start after the dynamic objects instead
+                if(segmentUsed)
+                    segment++;
+
+                segmentUsed = false;
+                pendingDynamic.clear();
+                break;
+            }
+        }
+
+        objectSegments[i] = segment;
+        segmentUsed = true;
+    }
+
+    auto &segments = chunk.layers[z - 1];
+
+    // free unused segments
+    segments.resize(segmentUsed ? segment + 1 : segment);
+
+    const int chunkPixels = World::chunkSize * World::tileSize;
+
+    for(size_t s = 0; s < segments.size(); s++)
+    {
+        auto &texture = segments[s].texture;
+
+        if(!texture)
+        {
+            texture = renderer.createTarget(chunkPixels, chunkPixels);
+
+            if(!texture)
+                return false;
+        }
+
+        renderer.setTarget(texture);
+        renderer.setDrawColour(0, 0, 0, 0);
+        renderer.clear();
+
+        bool first = true;
+
+        for(size_t i = 0; i < chunk.objects.size(); i++)
+        {
+            if(objectSegments[i] != int(s))
+                continue;
+
+            auto &sprite = *chunk.objects[i];
+
+            if(first)
+                segments[s].firstOrder = sprite.order;
+
+            first = false;
+
+            renderSprite(renderer, sprite, 1.0f, chunkX * chunkPixels, chunkY * chunkPixels, z, 1.0f);
+        }
+    }
+
+    return true;
+}
+
+void WorldRenderer::renderLayer(Renderer &renderer, const RenderSnapshot &snapshot, float alpha, int z, bool useChunks, int viewX, int viewY, float viewZoom, int minX, int minY, int maxX, int maxY)
+{
+    if(!useChunks)
+    {
+        forEachObject(snapshot, [&](const Sprite &sprite)
+        {
+            renderSprite(renderer, sprite, alpha, viewX, viewY, z, viewZoom);
+        });
+
+        return;
+    }
+
+    for(int y = minY; y <= maxY; y++)
+    {
+        for(int x = minX; x <= maxX; x++)
+            chunks[x + y * chunksX].nextSegment = 0;
+    }
+
+    for(auto &sprite : snapshot.dynamicObjects)
+    {
+        // draw the cached objects that were before this one
+        int objMinX, objMinY, objMaxX, objMaxY;
+
+        if(getChunkRange(sprite, objMinX, objMinY, objMaxX, objMaxY))
+        {
+            renderChunks(renderer, z, sprite.order, viewX, viewY, viewZoom,
+                         std::max(minX, objMinX), std::max(minY, objMinY), std::min(maxX, objMaxX), std::min(maxY, objMaxY));
+        }
+
+        renderSprite(renderer, sprite, alpha, viewX, viewY, z, viewZoom);
+    }
+
+    // everything else
+    renderChunks(renderer, z, ~0u, viewX, viewY, viewZoom, minX, minY, maxX, maxY);
+}
+
+void WorldRenderer::renderChunks(Renderer &renderer, int z, uint32_t beforeOrder, int viewX, int viewY, float viewZoom, int minX, int minY, int maxX, int maxY)
+{
+    const int chunkPixels = World::chunkSize * World::tileSize;
+
+    for(int y = minY; y <= maxY; y++)
+    {
+        for(int x = minX; x <= maxX; x++)
+        {
+            auto &chunk = chunks[x + y * chunksX];
+            auto &segments = chunk.layers[z - 1];
+
+            for(; chunk.nextSegment < segments.size() && segments[chunk.nextSegment].firstOrder < beforeOrder; chunk.nextSegment++)
+            {
+                // round the same way as renderSprite to avoid gaps
+                int x0 = static_cast<int>(x * chunkPixels * viewZoom);
+                int y0 = static_cast<int>(y * chunkPixels * viewZoom);
+                int x1 = static_cast<int>((x + 1) * chunkPixels * viewZoom);
+                int y1 = static_cast<int>((y + 1) * chunkPixels * viewZoom);
+
+                SDL_Rect dr{x0 - viewX, y0 - viewY, x1 - x0, y1 - y0};
+                renderer.copy(*segments[chunk.nextSegment].texture, nullptr, &dr);
+            }
+        }
+    }
+}
+
+// chunks covered by an object's bitmap, false for objects that aren't tile aligned
+bool WorldRenderer::getChunkRange(const Sprite &sprite, int &minX, int &minY, int &maxX, int &maxY)
+{
+    auto data = sprite.data;
+
+    if(!data || data->bitmapOccupancy.empty())
+        return false;
+
+    const int chunkSize = World::chunkSize;
+
+    minX = std::max(0, sprite.x / chunkSize);
+    minY = std::max(0, sprite.y / chunkSize);
+    maxX = static_cast<int>(sprite.x + data->bitmapSizeX - 1) / chunkSize;
+    maxY = static_cast<int>(sprite.y + data->bitmapSizeY - 1) / chunkSize;
+
+    return true;
+}
+
+// if the tiles drawn in a layer overlap
+// (dynamic objects include both halves of split frames, as the frameset could change without updating the chunk)
+bool WorldRenderer::layerOverlaps(const Sprite &a, const Sprite &b, int z)
+{
+    auto forEachRect = [z](const Sprite &sprite, auto func)
+    {
+        auto &rects = sprite.data->occupancyRects;
+        bool split = !sprite.isStatic || (sprite.frameset && sprite.frameset->splitFrames);
+
+        for(int layer = z; layer >= (split ? z - 1 : z); layer--)
+        {
+            if(layer >= int(rects.size()))
+                continue;
+
+            for(auto &rect : rects[layer])
+            {
+                if(func(sprite.x + rect.x, sprite.y + rect.y, rect.w, rect.h))
+                    return true;
+            }
+        }
+
+        return false;
+    };
+
+    return forEachRect(a, [&](int ax, int ay, int aw, int ah)
+    {
+        return forEachRect(b, [&](int bx, int by, int bw, int bh)
+        {
+            return ax < bx + bw && bx < ax + aw && ay < by + bh && by < ay + ah;
+        });
+    });
+}
+
+void WorldRenderer::renderSprite(Renderer &renderer, const Sprite &sprite, float alpha, int scrollX, int scrollY, int z, float zoom)
+{
+    renderer.beginObject();
+
+    auto &texture = sprite.texture;
+    auto data = sprite.data;
+
+    if(!texture || !data)
+        return;
+
+    auto tileSize = World::tileSize;
+
+    // same as Object::getFrameSize
+    int frameW, frameH;
+
+    if(!data->bitmapOccupancy.empty())
+    {
+        frameW = data->bitmapSizeX * tileSize;
+        frameH = data->bitmapSizeY * tileSize;
+    }
+    else
+    {
+        frameW = texture->width / data->totalFrames;
+        frameH = texture->height;
+    }
+
+    // animation info
+    auto frameset = sprite.frameset;
+
+    int frameOffset = sprite.frame * frameW;
+
+    // if there's no occupancy data, draw the whole thing
+    if(data->bitmapOccupancy.empty() && z == 6)
+    {
+        // somewhere between where it was and where it is now
+        float pixelX = sprite.lastPixelX + (sprite.pixelX - sprite.lastPixelX) * alpha;
+        float pixelY = sprite.lastPixelY + (sprite.pixelY - sprite.lastPixelY) * alpha;
+
+        // ... using pixel offsets
+        SDL_Rect dr{
+            static_cast<int>(pixelX * zoom) - scrollX,
+            static_cast<int>(pixelY * zoom) - scrollY,
+            static_cast<int>(frameW * zoom),
+            static_cast<int>(frameH * zoom)
+        };
+
+        SDL_Rect sr = {
+            frameOffset,
+            0,
+            frameW,
+            frameH
+        };
+
+        bool flipX = frameset && frameset->flipX;
+
+        // also need to apply hotspot
+        // (definitely used for the rainbow)
+        dr.x -= data->hotspotX * zoom;
+        dr.y -= data->hotspotY * zoom;
+
+        renderer.copy(*texture, &sr, &dr, flipX);
+        return;
+    }
+
+    // "split" frames render a second image above the first one
+    bool split = frameset ? frameset->splitFrames : false;
+
+    if(z > data->maxBitmapOccupancy + (split ? 1 : 0))
+        return;
+
+    // copy merged rects of tiles
+    auto copyRects = [&](const std::vector<ObjectData::TileRect> &rects, int srcOffset)
+    {
+        for(auto &rect : rects)
+        {
+            // TODO: x flip
+            SDL_Rect sr{srcOffset + rect.x * tileSize, rect.y * tileSize, rect.w * tileSize, rect.h * tileSize};
+
+            // round each edge the same way as individual tiles would be
+            int x0 = static_cast<int>((sprite.x + rect.x) * tileSize * zoom);
+            int y0 = static_cast<int>((sprite.y + rect.y) * tileSize * zoom);
+            int x1 = static_cast<int>((sprite.x + rect.x + rect.w) * tileSize * zoom);
+            int y1 = static_cast<int>((sprite.y + rect.y + rect.h) * tileSize * zoom);
+
+            SDL_Rect dr{x0 - scrollX, y0 - scrollY, x1 - x0, y1 - y0};
+
+            renderer.copy(*texture, &sr, &dr);
+        }
+    };
+
+    auto &rects = data->occupancyRects;
+
+    if(z < int(rects.size()))
+        copyRects(rects[z], frameOffset);
+
+    // second layer, a bit higher
+    if(split && z - 1 < int(rects.size()))
+        copyRects(rects[z - 1], frameOffset + frameW);
+}
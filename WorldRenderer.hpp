@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "RenderSnapshot.hpp"
+#include "Renderer.hpp"
+
+// draws snapshots of the world, keeps everything that only the render thread needs
+class WorldRenderer final
+{
+public:
+    // alpha is how far to interpolate from the start to the end of the snapshot's tick
+    void render(Renderer &renderer, const RenderSnapshot &snapshot, float alpha);
+
+    // render at 1x and scale once instead of scaling everything
+    void setRenderNativeScale(bool enabled);
+
+    // cached textures were lost (SDL_RENDER_TARGETS_RESET)
+    void invalidate();
+
+private:
+    using Sprite = RenderSnapshot::Sprite;
+
+    // pre-rendered static objects, split where they need to be drawn over a dynamic object
+    struct Segment
+    {
+        std::shared_ptr<Texture> texture;
+        uint32_t firstOrder = 0; // drawn before dynamic objects after this
+    };
+
+    struct Chunk
+    {
+        std::vector<Segment> layers[6]; // z 1-6
+        std::vector<const Sprite *> objects; // only used while updating, includes dynamic objects
+        uint32_t version = 0; // last drawn, 0 if never
+        size_t nextSegment = 0; // while drawing a layer
+    };
+
+    void renderView(Renderer &renderer, const RenderSnapshot &snapshot, float alpha, int viewX, int viewY, float viewZoom, int viewWidth, int viewHeight);
+
+    void updateChunks(Renderer &renderer, const RenderSnapshot &snapshot, int minX, int minY, int maxX, int maxY);
+    bool updateChunkLayer(Renderer &renderer, Chunk &chunk, int chunkX, int chunkY, int z);
+
+    // draws objects in a layer, using cached chunks if enabled
+    void renderLayer(Renderer &renderer, const RenderSnapshot &snapshot, float alpha, int z, bool useChunks, int viewX, int viewY, float viewZoom, int minX, int minY, int maxX, int maxY);
+    void renderChunks(Renderer &renderer, int z, uint32_t beforeOrder, int viewX, int viewY, float viewZoom, int minX, int minY, int maxX, int maxY);
+
+    static bool getChunkRange(const Sprite &sprite, int &minX, int &minY, int &maxX, int &maxY);
+    static bool layerOverlaps(const Sprite &a, const Sprite &b, int z);
+
+    static void renderSprite(Renderer &renderer, const Sprite &sprite, float alpha, int scrollX, int scrollY, int z, float zoom);
+
+    bool renderNativeScale = false;
+    int offscreenWidth = 0, offscreenHeight = 0;
+    std::shared_ptr<Texture> offscreen;
+
+    bool useChunkCache = true;
+    unsigned int chunksX = 0, chunksY = 0;
+    std::vector<Chunk> chunks;
+
+    // used while updating a chunk
+    std::vector<const Sprite *> pendingDynamic;
+    std::vector<int> objectSegments;
+};